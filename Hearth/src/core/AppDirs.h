@@ -33,6 +33,7 @@ namespace Hearth::AppDirs {
 // |-- ~recovery/
 // |   |-- notebooks/
 // |   +-- notepad/
+// |-- ~undo/
 // |-- backups/
 // |   |-- notebooks/
 // |   +-- notepad/
@@ -68,6 +69,7 @@ GEN_DIR_METHOD_(tempNotebooks, userData() / "~notebooks")
 GEN_DIR_METHOD_(tempRecovery, userData() / "~recovery")
 GEN_DIR_METHOD_(tempNotebookRecovery, tempRecovery() / "notebooks")
 GEN_DIR_METHOD_(tempNotepadRecovery, tempRecovery() / "notepad")
+GEN_DIR_METHOD_(tempUndo, userData() / "~undo")
 GEN_DIR_METHOD_(backups, userData() / "backups")
 GEN_DIR_METHOD_(notebookBackups, backups() / "notebooks")
 GEN_DIR_METHOD_(notepadBackups, backups() / "notepad")
@@ -86,7 +88,8 @@ inline void cleanup()
     for (auto& dir : { tempNotepadRecovery(),
                        tempNotebookRecovery(),
                        tempRecovery(),
-                       tempNotebooks() }) {
+                       tempNotebooks(),
+                       tempUndo() }) {
         Coco::rmdir(dir); // Fails if the dir isn't empty
     }
 }
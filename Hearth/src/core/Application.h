@@ -28,6 +28,7 @@
 #include "core/LogViewer.h"
 #include "core/Version.h"
 #include "dialogs/BetaAlert.h"
+#include "models/UndoJournal.h"
 #include "workspaces/Notebook.h"
 #include "workspaces/Notepad.h"
 
@@ -68,6 +69,7 @@ public:
             new LogViewer; // Has delete on close attribute
         }
 
+        UndoJournal::removeStale(); // Left by a crash
         initializeTranslator_();
         loadBundledFonts_();
         initializeNotepad_();
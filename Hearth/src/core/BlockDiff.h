@@ -0,0 +1,255 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <optional>
+
+#include <QList>
+#include <QtTypes>
+
+// Sequence diff for lists of blocks (e.g., preview HTML blocks), as the runs
+// of old items replaced by runs of new ones. Uses Myers' greedy O((N + M)D)
+// algorithm after trimming the common head and tail, so a local edit in a
+// long list costs about as much as comparing the ends
+namespace Hearth::BlockDiff {
+
+// Old items [oldStart, oldStart + oldCount) become new items [newStart,
+// newStart + newCount). Either count may be 0 (a pure insertion or removal).
+// Items between hunks are unchanged
+struct Hunk
+{
+    qsizetype oldStart = 0;
+    qsizetype oldCount = 0;
+    qsizetype newStart = 0;
+    qsizetype newCount = 0;
+};
+
+namespace Internal {
+
+    // One insertion or removal, from point (x, y) on the edit graph
+    struct Edit_
+    {
+        bool insert;
+        qsizetype x;
+        qsizetype y;
+    };
+
+    inline QList<Hunk>
+    toHunks_(const QList<Edit_>& edits, qsizetype offset)
+    {
+        QList<Hunk> hunks{};
+
+        for (auto& edit : edits) {
+            auto joins = !hunks.isEmpty()
+                         && hunks.last().oldStart + hunks.last().oldCount
+                                == edit.x + offset
+                         && hunks.last().newStart + hunks.last().newCount
+                                == edit.y + offset;
+
+            if (!joins) hunks << Hunk{ edit.x + offset, 0, edit.y + offset, 0 };
+
+            if (edit.insert)
+                ++hunks.last().newCount;
+            else
+                ++hunks.last().oldCount;
+        }
+
+        return hunks;
+    }
+
+} // namespace Internal
+
+// equal(i, j) says whether old item i matches new item j. Returns nullopt if
+// the lists differ by more than maxEdits insertions and removals (not counting
+// the trimmed ends), where a caller is likely better off replacing everything
+template <typename EqualT>
+inline std::optional<QList<Hunk>> hunks(
+    qsizetype oldSize,
+    qsizetype newSize,
+    EqualT&& equal,
+    qsizetype maxEdits)
+{
+    qsizetype head = 0;
+    while (head < oldSize && head < newSize && equal(head, head))
+        ++head;
+
+    qsizetype tail = 0;
+    while (tail < oldSize - head && tail < newSize - head
+           && equal(oldSize - 1 - tail, newSize - 1 - tail))
+        ++tail;
+
+    auto n = oldSize - head - tail;
+    auto m = newSize - head - tail;
+
+    if (n == 0 && m == 0) return QList<Hunk>{};
+    if (n == 0 || m == 0) return QList<Hunk>{ Hunk{ head, n, head, m } };
+
+    auto max = std::min(n + m, maxEdits);
+    if (max < 1) return std::nullopt;
+
+    // v[k + max + 1] is the furthest x reached on diagonal k (x - y). Each
+    // step's slice of diagonals [-d, d] is kept for the walk back
+    QList<qsizetype> v(2 * max + 3, 0);
+    QList<QList<qsizetype>> trace{};
+
+    auto at = [&](qsizetype k) -> qsizetype& { return v[k + max + 1]; };
+
+    for (qsizetype d = 0; d <= max; ++d) {
+        for (auto k = -d; k <= d; k += 2) {
+            auto down = k == -d || (k != d && at(k - 1) < at(k + 1));
+            auto x = down ? at(k + 1) : at(k - 1) + 1;
+            auto y = x - k;
+
+            while (x < n && y < m && equal(head + x, head + y)) {
+                ++x;
+                ++y;
+            }
+
+            at(k) = x;
+            if (x < n || y < m) continue;
+
+            // Reached the end: walk back through the steps, collecting the one
+            // edit each made
+            QList<Internal::Edit_> edits{};
+
+            for (auto e = d; e > 0; --e) {
+                auto& prev = trace[e - 1]; // Diagonals [-(e - 1), e - 1]
+                auto prev_at = [&](qsizetype pk) { return prev[pk + e - 1]; };
+
+                auto ek = x - y;
+                auto prev_down =
+                    ek == -e || (ek != e && prev_at(ek - 1) < prev_at(ek + 1));
+                auto prev_k = prev_down ? ek + 1 : ek - 1;
+                auto prev_x = prev_at(prev_k);
+                auto prev_y = prev_x - prev_k;
+
+                edits << Internal::Edit_{ prev_down, prev_x, prev_y };
+                x = prev_x;
+                y = prev_y;
+            }
+
+            std::reverse(edits.begin(), edits.end());
+            return Internal::toHunks_(edits, head);
+        }
+
+        trace << v.sliced(max + 1 - d, 2 * d + 1);
+    }
+
+    return std::nullopt;
+}
+
+} // namespace Hearth::BlockDiff
+
+// Tests:
+
+/*#include <utility>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "core/Debug.h"
+#include "views/AbstractMarkupFileView.h" // MarkupRenderer::hash
+
+namespace BlockDiffBenchmark {
+
+using namespace Qt::StringLiterals;
+
+inline QStringList blocks(int count, int insertAt = -1)
+{
+    QStringList blocks{};
+    auto index = 0;
+
+    for (auto i = 0; i < count; ++i) {
+        if (i == insertAt)
+            blocks << u"<p data-idx='%1'>A new paragraph</p>"_s.arg(index++);
+
+        blocks << u"<p data-idx='%1'>Paragraph %2, with some text in it so "
+                  "it's about as long as a paragraph of prose would be</p>"_s
+                      .arg(index++)
+                      .arg(i);
+    }
+
+    return blocks;
+}
+
+inline QList<size_t> hashes(const QStringList& blocks)
+{
+    QList<size_t> hashes{};
+    hashes.reserve(blocks.size());
+    for (auto& block : blocks)
+        hashes << Hearth::MarkupRenderer::hash(block);
+
+    return hashes;
+}
+
+// 10k blocks: one changed in the middle (the old same-count path compared
+// every string), and one inserted in the middle (which used to replace the
+// whole body)
+inline void run()
+{
+    constexpr auto count = 10'000;
+    auto shown = blocks(count);
+    auto edited = shown;
+    edited[count / 2] = u"<p data-idx='%1'>Edited</p>"_s.arg(count / 2);
+    auto inserted = blocks(count, count / 2);
+
+    QElapsedTimer timer{};
+
+    timer.start();
+    auto changed = 0;
+    for (auto i = 0; i < count; ++i)
+        if (edited[i] != shown[i]) ++changed;
+    auto strings_ns = timer.nsecsElapsed();
+
+    timer.restart();
+    auto shown_hashes = hashes(shown);
+    auto edited_hashes = hashes(edited);
+    auto inserted_hashes = hashes(inserted);
+    auto hashing_ns = timer.nsecsElapsed() / 3;
+
+    auto diff = [&](const QList<size_t>& next) {
+        QElapsedTimer diff_timer{};
+        diff_timer.start();
+
+        auto hunks = Hearth::BlockDiff::hunks(
+            shown_hashes.size(),
+            next.size(),
+            [&](qsizetype i, qsizetype j) {
+                return shown_hashes[i] == next[j];
+            },
+            256);
+
+        return std::pair{ diff_timer.nsecsElapsed(),
+                          hunks ? hunks->size() : -1 };
+    };
+
+    auto [edit_ns, edit_hunks] = diff(edited_hashes);
+    auto [insert_ns, insert_hunks] = diff(inserted_hashes);
+
+    DEBUG(
+        "{} blocks: string compare {} us ({} changed), hashing {} us, "
+        "hash diff {} us edit ({} hunks), {} us insert ({} hunks)",
+        count,
+        strings_ns / 1000,
+        changed,
+        hashing_ns / 1000,
+        edit_ns / 1000,
+        edit_hunks,
+        insert_ns / 1000,
+        insert_hunks);
+}
+
+} // namespace BlockDiffBenchmark*/
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include <QByteArray>
 #include <QFile>
 #include <QIODevice>
@@ -50,9 +52,12 @@ inline QByteArray read(const Coco::Path& path)
     return file.readAll();
 }
 
+// Writer should return false on failure, in which case nothing is committed
+using Writer = std::function<bool(QIODevice&)>;
+
 inline bool write(
-    const QByteArray& data,
     const Coco::Path& path,
+    const Writer& writer,
     CreateDirs createDirs = CreateDirs::Yes)
 {
     if (path.isEmpty()) {
@@ -78,10 +83,9 @@ inline bool write(
         return false;
     }
 
-    auto written = file.write(data);
-
-    if (written != data.size()) {
+    if (!writer || !writer(file)) {
         WARN("Failed to write all data to file at {}!", path);
+        file.cancelWriting();
         return false;
     }
 
@@ -94,4 +98,17 @@ inline bool write(
     return true;
 }
 
+inline bool write(
+    const QByteArray& data,
+    const Coco::Path& path,
+    CreateDirs createDirs = CreateDirs::Yes)
+{
+    return write(
+        path,
+        [&data](QIODevice& device) {
+            return device.write(data) == data.size();
+        },
+        createDirs);
+}
+
 } // namespace Hearth::Io
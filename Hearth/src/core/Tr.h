@@ -308,6 +308,10 @@ namespace Tr {
     TR_(editorPanelLineHighlight, tr("Highlight current line"));
     TR_(editorPanelSelectionHandles, tr("Selection handles"));
     TR_(editorPanelLeftRightMargin, tr("Left/Right margin:"));
+    TR_(editorPanelUndoMemory, tr("Undo memory (MB):"));
+    TR_(editorPanelUndoMemoryTooltip,
+        tr("How much undo history large files keep in memory. Older steps "
+           "are moved to disk and read back when you undo that far."));
 
     /// Word counter panel
 
@@ -333,6 +337,14 @@ namespace Tr {
     TR_(colorBarPanelAboveStatusBar, tr("Above status bar"));
     TR_(colorBarPanelBottom, tr("Bottom"));
 
+    /// Notebook panel
+
+    TR_(notebookPanelTitle, tr("Notebook"));
+    TR_(notebookPanelCompression, tr("Compression:"));
+    TR_(notebookPanelFast, tr("Fast"));
+    TR_(notebookPanelBalanced, tr("Balanced"));
+    TR_(notebookPanelSmall, tr("Small"));
+
     /// Settings Dialog
 
     TR_(settingsTitle, tr("Settings"));
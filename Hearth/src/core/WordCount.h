@@ -0,0 +1,260 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <bit>
+
+#include <QChar>
+#include <QStringView>
+#include <QtTypes>
+
+#if defined(__AVX2__)
+#    include <immintrin.h>
+#    define HEARTH_WORD_COUNT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)                                     \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define HEARTH_WORD_COUNT_SSE2
+#endif
+
+// Word counting for UTF-16 text: the number of transitions from whitespace to
+// non-whitespace, where whitespace is whatever QChar::isSpace() says it is.
+// Shared by document counts (BlockCounts), selection counts, and anything else
+// that needs the same answer
+//
+// On x86 the text is classified 16 (SSE2) or 32 (AVX2, when the build enables
+// it) code units at a time. Each step makes a whitespace bitmask, and word
+// starts are the non-space bits whose preceding bit is space, so a step is a
+// handful of compares, a shift, and a popcount. The vector classifier tests
+// for each code unit QChar::isSpace() accepts in the BMP (ASCII and Latin-1
+// controls and spaces, plus the Unicode Zs/Zl/Zp separators). Surrogates are
+// never space, so non-BMP text counts the same unit by unit as it does by
+// code point. The scalar loop handles the tail, other architectures, and is
+// the reference the vector paths must agree with
+namespace Hearth::WordCount {
+
+namespace Internal {
+
+    // Continues a count across calls. prevSpace is whether the unit before
+    // data was whitespace (true at the start of text)
+    inline int scalar_(const char16_t* data, qsizetype size, bool& prevSpace)
+    {
+        auto count = 0;
+
+        for (qsizetype i = 0; i < size; ++i) {
+            auto space = QChar::isSpace(data[i]);
+            if (!space && prevSpace) ++count;
+            prevSpace = space;
+        }
+
+        return count;
+    }
+
+#if defined(HEARTH_WORD_COUNT_AVX2)
+
+    inline __m256i spaces_(__m256i units)
+    {
+        auto eq = [&](short ch) {
+            return _mm256_cmpeq_epi16(units, _mm256_set1_epi16(ch));
+        };
+
+        // Unsigned first <= unit <= first + span
+        auto in = [&](short first, short span) {
+            auto offset = _mm256_sub_epi16(units, _mm256_set1_epi16(first));
+            return _mm256_cmpeq_epi16(
+                _mm256_subs_epu16(offset, _mm256_set1_epi16(span)),
+                _mm256_setzero_si256());
+        };
+
+        auto latin1 = _mm256_or_si256(
+            _mm256_or_si256(eq(0x20), in(0x09, 0x0D - 0x09)),
+            _mm256_or_si256(eq(0x85), eq(0xA0)));
+
+        auto unicode = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_or_si256(eq(0x1680), in(0x2000, 0x200A - 0x2000)),
+                _mm256_or_si256(in(0x2028, 0x2029 - 0x2028), eq(0x202F))),
+            _mm256_or_si256(eq(0x205F), eq(0x3000)));
+
+        return _mm256_or_si256(latin1, unicode);
+    }
+
+    // Bit i set if data[i] is whitespace, for 32 units
+    inline quint32 spaceMask_(const char16_t* data)
+    {
+        auto low = spaces_(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)));
+        auto high = spaces_(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 16)));
+
+        // Packing works within 128-bit lanes, so the quarters come out as low,
+        // high, low, high and are put back in order
+        auto packed =
+            _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+
+        return quint32(_mm256_movemask_epi8(packed));
+    }
+
+    constexpr qsizetype STEP_ = 32;
+
+#elif defined(HEARTH_WORD_COUNT_SSE2)
+
+    inline __m128i spaces_(__m128i units)
+    {
+        auto eq = [&](short ch) {
+            return _mm_cmpeq_epi16(units, _mm_set1_epi16(ch));
+        };
+
+        // Unsigned first <= unit <= first + span
+        auto in = [&](short first, short span) {
+            auto offset = _mm_sub_epi16(units, _mm_set1_epi16(first));
+            return _mm_cmpeq_epi16(
+                _mm_subs_epu16(offset, _mm_set1_epi16(span)),
+                _mm_setzero_si128());
+        };
+
+        auto latin1 = _mm_or_si128(
+            _mm_or_si128(eq(0x20), in(0x09, 0x0D - 0x09)),
+            _mm_or_si128(eq(0x85), eq(0xA0)));
+
+        auto unicode = _mm_or_si128(
+            _mm_or_si128(
+                _mm_or_si128(eq(0x1680), in(0x2000, 0x200A - 0x2000)),
+                _mm_or_si128(in(0x2028, 0x2029 - 0x2028), eq(0x202F))),
+            _mm_or_si128(eq(0x205F), eq(0x3000)));
+
+        return _mm_or_si128(latin1, unicode);
+    }
+
+    // Bit i set if data[i] is whitespace, for 16 units
+    inline quint32 spaceMask_(const char16_t* data)
+    {
+        auto low =
+            spaces_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+        auto high = spaces_(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 8)));
+
+        return quint32(_mm_movemask_epi8(_mm_packs_epi16(low, high)));
+    }
+
+    constexpr qsizetype STEP_ = 16;
+
+#endif
+
+} // namespace Internal
+
+inline int count(QStringView text)
+{
+    auto data = text.utf16();
+    auto size = text.size();
+    auto count = 0;
+    auto prev_space = true;
+    qsizetype i = 0;
+
+#if defined(HEARTH_WORD_COUNT_AVX2) || defined(HEARTH_WORD_COUNT_SSE2)
+
+    constexpr quint64 full = (quint64(1) << Internal::STEP_) - 1;
+    quint64 carry = 1;
+
+    for (; i + Internal::STEP_ <= size; i += Internal::STEP_) {
+        quint64 spaces = Internal::spaceMask_(data + i);
+        auto starts = ~spaces & ((spaces << 1) | carry) & full;
+
+        count += std::popcount(starts);
+        carry = spaces >> (Internal::STEP_ - 1);
+    }
+
+    prev_space = carry;
+
+#endif
+
+    return count + Internal::scalar_(data + i, size - i, prev_space);
+}
+
+} // namespace Hearth::WordCount
+
+// Tests:
+
+/*#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+#include "core/Debug.h"
+
+namespace WordCountBenchmark {
+
+// The loop WordCount::count replaced
+inline int loop(const QString& text)
+{
+    auto count = 0;
+    auto in_word = false;
+
+    for (auto& ch : text) {
+        if (ch.isSpace() || ch == QChar::ParagraphSeparator) {
+            in_word = false;
+        } else if (!in_word) {
+            in_word = true;
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+// Prose with some of everything: tabs, line breaks, no-break, em, and
+// ideographic spaces, U+2029, curly quotes, Cyrillic, CJK, and a surrogate pair
+inline QString sample(qsizetype bytes)
+{
+    const QString line = QStringLiteral(
+        "The “quick” brown fox\tjumps over the lazy\u00A0dog\u2003— "
+        "\u0441\u043E\u0431\u0430\u043A\u0430\n\u72AC\u3000\U0001F98A!\u2029");
+
+    QString text{};
+    text.reserve(bytes / 2);
+    while (text.size() * 2 < bytes)
+        text += line;
+
+    return text;
+}
+
+inline void run()
+{
+    for (auto mebibytes : { 1, 50 }) {
+        auto text = sample(mebibytes * 1024 * 1024);
+        QElapsedTimer timer{};
+
+        timer.start();
+        auto expected = loop(text);
+        auto loop_ms = timer.elapsed();
+
+        timer.restart();
+        auto actual = Hearth::WordCount::count(text);
+        auto kernel_ms = timer.elapsed();
+
+        // Every offset, so each lane position meets each kind of unit
+        auto agree = expected == actual;
+        for (auto i = 0; agree && i < 64; ++i)
+            agree = loop(text.mid(i, 4096))
+                    == Hearth::WordCount::count(QStringView(text).mid(i, 4096));
+
+        DEBUG(
+            "{} MiB: loop {} ms, kernel {} ms ({} words, agree: {})",
+            mebibytes,
+            loop_ms,
+            kernel_ms,
+            actual,
+            agree);
+    }
+}
+
+} // namespace WordCountBenchmark*/
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <QByteArray>
+#include <QIODevice>
 #include <QObject>
 #include <QString>
 
@@ -47,6 +48,14 @@ public:
     virtual QByteArray data() const = 0;
     virtual void setData(const QByteArray& data) = 0;
 
+    // Saving goes through here. Override to stream content rather than build
+    // it all in memory first
+    virtual bool write(QIODevice& device) const
+    {
+        auto bytes = data();
+        return device.write(bytes) == bytes.size();
+    }
+
     virtual bool isUserEditable() const { return false; }
     virtual bool hasUndo() const { return false; }
     virtual bool hasRedo() const { return false; }
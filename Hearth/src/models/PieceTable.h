@@ -0,0 +1,621 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include <QByteArray>
+#include <QChar>
+#include <QIODevice>
+#include <QList>
+#include <QString>
+#include <QStringEncoder>
+#include <QStringView>
+
+#include "models/UndoJournal.h"
+
+namespace Hearth {
+
+// Plain text as a sequence of pieces over two buffers: the original text
+// (never modified) and an append-only buffer of everything inserted since.
+// Edits splice pieces rather than moving text, and undo history is kept as
+// the pieces each edit removed and inserted, so neither editing nor undo ever
+// copies document text.
+//
+// Positions are in QChar units with '\n' line breaks, matching QTextDocument
+// positions. Not a QObject; see PieceTablePrimeStore.
+//
+// History can be bounded (see setUndoBudget): the oldest steps spill to an
+// UndoJournal on disk and page back in when undo reaches them
+class PieceTable
+{
+public:
+    // A change as seen from outside (what views need to replay it)
+    struct Delta
+    {
+        qsizetype pos = 0;
+        qsizetype removed = 0;
+        QString added{};
+    };
+
+    // Replaces the text and clears history
+    void reset(const QString& text)
+    {
+        original_ = text;
+        added_.clear();
+        pieces_.clear();
+        if (!original_.isEmpty())
+            pieces_ << Piece_{ Piece_::Original, 0, original_.size() };
+        length_ = original_.size();
+
+        steps_.clear();
+        journal_.clear();
+        stepIndex_ = 0;
+        cleanIndex_ = 0;
+        historyChars_ = 0;
+        compactAt_ = 0;
+        groupDepth_ = 0;
+        groupOpen_ = false;
+        mergeable_ = false;
+    }
+
+    // Bounds the text (in QChars) that in-memory undo history holds. Past it,
+    // the oldest steps spill to disk, and inserted text only they referenced
+    // is dropped from memory. 0 is unbounded
+    void setUndoBudget(qsizetype chars)
+    {
+        undoBudget_ = qMax(chars, qsizetype(0));
+        enforceUndoBudget_();
+    }
+
+    qsizetype undoBudget() const noexcept { return undoBudget_; }
+    qsizetype spilledSteps() const noexcept { return journal_.size(); }
+
+    qsizetype length() const noexcept { return length_; }
+    qsizetype pieceCount() const noexcept { return pieces_.size(); }
+
+    QString text() const { return mid(0, length_); }
+
+    QString mid(qsizetype pos, qsizetype count) const
+    {
+        QString text{};
+        pos = qBound(qsizetype(0), pos, length_);
+        count = qBound(qsizetype(0), count, length_ - pos);
+        if (count == 0) return text;
+
+        text.reserve(count);
+        qsizetype start = 0;
+
+        for (auto& piece : pieces_) {
+            auto end = start + piece.length;
+
+            if (end > pos) {
+                auto offset = qMax(pos - start, qsizetype(0));
+                auto take = qMin(piece.length - offset, count - text.size());
+                text += viewOf_(piece).sliced(offset, take);
+                if (text.size() == count) break;
+            }
+
+            start = end;
+        }
+
+        return text;
+    }
+
+    // Transcodes piece by piece, so the document is never copied as a whole.
+    // QStringEncoder is stateful, so surrogate pairs split across pieces still
+    // encode correctly
+    bool writeUtf8(QIODevice& device) const
+    {
+        constexpr qsizetype chunk = 64 * 1024;
+        QStringEncoder encoder(QStringEncoder::Utf8);
+
+        for (auto& piece : pieces_) {
+            auto view = viewOf_(piece);
+
+            for (qsizetype i = 0; i < view.size(); i += chunk) {
+                auto slice = view.sliced(i, qMin(chunk, view.size() - i));
+                QByteArray bytes = encoder(slice);
+                if (device.write(bytes) != bytes.size()) return false;
+            }
+        }
+
+        return !encoder.hasError();
+    }
+
+    QByteArray toUtf8() const { return text().toUtf8(); }
+
+    // Records one edit. Consecutive single-character typing or deleting
+    // (without line breaks) merges into one undo step, as it does in
+    // QTextDocument
+    void replace(qsizetype pos, qsizetype removed, const QString& added)
+    {
+        pos = qBound(qsizetype(0), pos, length_);
+        removed = qBound(qsizetype(0), removed, length_ - pos);
+        if (removed == 0 && added.isEmpty()) return;
+
+        Piece_ inserted{ Piece_::Added, added_.size(), added.size() };
+        added_ += added;
+
+        Edit_ edit{ pos, splice_(pos, removed, { inserted }), inserted };
+        historyChars_ += charsOf_(edit);
+
+        if (tryMerge_(edit)) {
+            enforceUndoBudget_();
+            return;
+        }
+
+        truncateRedo_();
+
+        if (groupDepth_ > 0 && stepIndex_ > 0 && groupOpen_) {
+            steps_[stepIndex_ - 1].edits << edit;
+        } else {
+            steps_ << Step_{ { edit } };
+            ++stepIndex_;
+            groupOpen_ = groupDepth_ > 0;
+        }
+
+        mergeable_ = groupDepth_ == 0 && isMergeable_(edit);
+        enforceUndoBudget_();
+    }
+
+    // Edits between begin and end undo as one step. May nest
+    void beginGroup()
+    {
+        if (groupDepth_++ == 0) {
+            groupOpen_ = false;
+            mergeable_ = false;
+        }
+    }
+
+    void endGroup()
+    {
+        if (groupDepth_ <= 0) return;
+        if (--groupDepth_ == 0) groupOpen_ = false;
+    }
+
+    bool canUndo() const noexcept
+    {
+        return stepIndex_ > 0 || !journal_.isEmpty();
+    }
+
+    bool canRedo() const noexcept { return stepIndex_ < steps_.size(); }
+
+    // Returns the changes made, in order
+    QList<Delta> undo()
+    {
+        if (!canUndo()) return {};
+        if (stepIndex_ == 0 && !pageIn_()) return {};
+
+        mergeable_ = false;
+        auto& step = steps_[--stepIndex_];
+        QList<Delta> deltas{};
+
+        for (auto i = step.edits.size() - 1; i >= 0; --i) {
+            auto& edit = step.edits[i];
+            splice_(edit.pos, edit.inserted.length, edit.removed);
+            deltas << Delta{ edit.pos,
+                             edit.inserted.length,
+                             textOf_(edit.removed) };
+        }
+
+        return deltas;
+    }
+
+    QList<Delta> redo()
+    {
+        if (!canRedo()) return {};
+
+        mergeable_ = false;
+        auto& step = steps_[stepIndex_++];
+        QList<Delta> deltas{};
+
+        for (auto& edit : step.edits) {
+            auto removed = lengthOf_(edit.removed);
+            splice_(edit.pos, removed, { edit.inserted });
+            deltas << Delta{ edit.pos, removed, textOf_({ edit.inserted }) };
+        }
+
+        return deltas;
+    }
+
+    // Unmodified means history is at the last clean point (e.g., the last
+    // save), so undoing back to it counts, like QTextDocument
+    bool isModified() const noexcept { return cleanIndex_ != appliedSteps_(); }
+
+    void setModified(bool modified) noexcept
+    {
+        cleanIndex_ = modified ? -1 : appliedSteps_();
+
+        // Don't let typing after a save merge into the saved step
+        mergeable_ = false;
+    }
+
+private:
+    struct Piece_
+    {
+        enum Buffer : quint8
+        {
+            Original,
+            Added
+        };
+
+        Buffer buffer = Original;
+        qsizetype start = 0;
+        qsizetype length = 0;
+    };
+
+    // Removed pieces still point into the buffers, which never lose text, so
+    // undoing an edit is a splice too
+    struct Edit_
+    {
+        qsizetype pos = 0;
+        QList<Piece_> removed{};
+        Piece_ inserted{};
+    };
+
+    struct Step_
+    {
+        QList<Edit_> edits{};
+    };
+
+    QString original_{};
+    QString added_{};
+    QList<Piece_> pieces_{};
+    qsizetype length_ = 0;
+
+    QList<Step_> steps_{};
+    qsizetype stepIndex_ = 0; // Steps applied (in memory)
+    qsizetype cleanIndex_ = 0; // Steps applied (spilled included)
+    int groupDepth_ = 0;
+    bool groupOpen_ = false; // A step exists for the current group
+    bool mergeable_ = false; // The last step may absorb the next edit
+
+    UndoJournal journal_{};
+    qsizetype undoBudget_ = 0;
+    qsizetype historyChars_ = 0; // Text referenced by in-memory steps
+    qsizetype compactAt_ = 0; // added_ size that triggers compaction
+
+    qsizetype appliedSteps_() const noexcept
+    {
+        return journal_.size() + stepIndex_;
+    }
+
+    QStringView viewOf_(const Piece_& piece) const
+    {
+        auto& buffer = piece.buffer == Piece_::Original ? original_ : added_;
+        return QStringView(buffer).sliced(piece.start, piece.length);
+    }
+
+    QString textOf_(const QList<Piece_>& pieces) const
+    {
+        QString text{};
+        text.reserve(lengthOf_(pieces));
+        for (auto& piece : pieces)
+            text += viewOf_(piece);
+        return text;
+    }
+
+    static qsizetype lengthOf_(const QList<Piece_>& pieces)
+    {
+        qsizetype length = 0;
+        for (auto& piece : pieces)
+            length += piece.length;
+        return length;
+    }
+
+    // Index of the piece that starts at pos, splitting a piece if pos falls
+    // inside it. Returns the piece count for the end of the text
+    qsizetype splitAt_(qsizetype pos)
+    {
+        qsizetype start = 0;
+
+        for (qsizetype i = 0; i < pieces_.size(); ++i) {
+            auto& piece = pieces_[i];
+            if (pos == start) return i;
+
+            if (pos < start + piece.length) {
+                auto offset = pos - start;
+                Piece_ right{ piece.buffer,
+                              piece.start + offset,
+                              piece.length - offset };
+                piece.length = offset;
+                pieces_.insert(i + 1, right);
+                return i + 1;
+            }
+
+            start += piece.length;
+        }
+
+        return pieces_.size();
+    }
+
+    // Replaces [pos, pos + removed) with the given pieces, returning the
+    // pieces removed
+    QList<Piece_>
+    splice_(qsizetype pos, qsizetype removed, const QList<Piece_>& inserted)
+    {
+        auto first = splitAt_(pos);
+        auto last = splitAt_(pos + removed);
+
+        auto removed_pieces = pieces_.mid(first, last - first);
+        pieces_.remove(first, last - first);
+
+        auto at = first;
+        for (auto& piece : inserted) {
+            if (piece.length <= 0) continue;
+            pieces_.insert(at++, piece);
+        }
+
+        length_ += lengthOf_(inserted) - removed;
+
+        // Rejoin neighbors that are contiguous in the same buffer (typing
+        // extends one piece rather than adding a piece per keystroke)
+        join_(at);
+        join_(first);
+
+        return removed_pieces;
+    }
+
+    // Joins the piece at index into the one before it, if they're contiguous
+    void join_(qsizetype index)
+    {
+        if (index <= 0 || index >= pieces_.size()) return;
+
+        auto& before = pieces_[index - 1];
+        auto& piece = pieces_[index];
+
+        if (before.buffer != piece.buffer
+            || before.start + before.length != piece.start)
+            return;
+
+        before.length += piece.length;
+        pieces_.removeAt(index);
+    }
+
+    void truncateRedo_()
+    {
+        if (stepIndex_ >= steps_.size()) return;
+
+        for (auto i = stepIndex_; i < steps_.size(); ++i)
+            historyChars_ -= charsOf_(steps_[i]);
+
+        steps_.resize(stepIndex_);
+        if (cleanIndex_ > appliedSteps_()) cleanIndex_ = -1;
+    }
+
+    static qsizetype charsOf_(const Edit_& edit)
+    {
+        return lengthOf_(edit.removed) + edit.inserted.length;
+    }
+
+    static qsizetype charsOf_(const Step_& step)
+    {
+        qsizetype chars = 0;
+        for (auto& edit : step.edits)
+            chars += charsOf_(edit);
+        return chars;
+    }
+
+    // Spills the oldest applied steps until history fits the budget. The
+    // latest step always stays in memory, since typing may still merge into
+    // it (and an open group may still add to it)
+    void enforceUndoBudget_()
+    {
+        if (undoBudget_ <= 0 || historyChars_ <= undoBudget_) return;
+
+        auto spilled = false;
+
+        while (historyChars_ > undoBudget_ && stepIndex_ > 1) {
+            auto& step = steps_.front();
+            UndoJournal::Step journal_step{};
+
+            for (auto& edit : step.edits)
+                journal_step << UndoJournal::Edit{
+                    edit.pos,
+                    textOf_(edit.removed),
+                    viewOf_(edit.inserted).toString()
+                };
+
+            if (!journal_.push(journal_step)) break;
+
+            historyChars_ -= charsOf_(step);
+            steps_.removeFirst();
+            --stepIndex_;
+            spilled = true;
+        }
+
+        if (spilled && added_.size() >= compactAt_) {
+            compactAdded_();
+            compactAt_ = qMax(undoBudget_, added_.size() * 2);
+        }
+    }
+
+    // Brings the most recently spilled step back to the front of history.
+    // Its text goes into the added buffer, so it's a piece edit like any other
+    bool pageIn_()
+    {
+        UndoJournal::Step journal_step{};
+
+        if (!journal_.pop(journal_step)) {
+            // Anything older is unreachable now. The clean point may have
+            // been among it, so assume modified
+            journal_.clear();
+            cleanIndex_ = -1;
+            return false;
+        }
+
+        Step_ step{};
+
+        for (auto& journal_edit : journal_step) {
+            Piece_ removed{ Piece_::Added,
+                            added_.size(),
+                            journal_edit.removed.size() };
+            added_ += journal_edit.removed;
+
+            Piece_ inserted{ Piece_::Added,
+                             added_.size(),
+                             journal_edit.inserted.size() };
+            added_ += journal_edit.inserted;
+
+            QList<Piece_> removed_pieces{};
+            if (removed.length > 0) removed_pieces << removed;
+
+            step.edits << Edit_{ journal_edit.pos, removed_pieces, inserted };
+        }
+
+        historyChars_ += charsOf_(step);
+        steps_.prepend(step);
+        ++stepIndex_;
+
+        return true;
+    }
+
+    // Rebuilds the added buffer from just the ranges that the document and
+    // in-memory history still reference
+    void compactAdded_()
+    {
+        struct Range_
+        {
+            qsizetype start = 0;
+            qsizetype end = 0;
+            qsizetype to = 0;
+        };
+
+        QList<Range_> ranges{};
+
+        auto collect = [&](const Piece_& piece) {
+            if (piece.buffer == Piece_::Added && piece.length > 0)
+                ranges << Range_{ piece.start, piece.start + piece.length };
+        };
+
+        for (auto& piece : pieces_)
+            collect(piece);
+
+        for (auto& step : steps_) {
+            for (auto& edit : step.edits) {
+                for (auto& piece : edit.removed)
+                    collect(piece);
+                collect(edit.inserted);
+            }
+        }
+
+        std::sort(ranges.begin(), ranges.end(), [](auto& a, auto& b) {
+            return a.start < b.start;
+        });
+
+        QList<Range_> merged{};
+
+        for (auto& range : ranges) {
+            if (!merged.isEmpty() && range.start <= merged.last().end)
+                merged.last().end = qMax(merged.last().end, range.end);
+            else
+                merged << range;
+        }
+
+        QString added{};
+        for (auto& range : merged) {
+            range.to = added.size();
+            added += QStringView(added_).sliced(
+                range.start,
+                range.end - range.start);
+        }
+
+        auto remap = [&](Piece_& piece) {
+            if (piece.buffer != Piece_::Added) return;
+
+            if (piece.length <= 0) {
+                piece.start = added.size();
+                return;
+            }
+
+            auto it = std::upper_bound(
+                merged.begin(),
+                merged.end(),
+                piece.start,
+                [](qsizetype start, auto& range) {
+                    return start < range.start;
+                });
+
+            auto& range = *(it - 1);
+            piece.start = range.to + piece.start - range.start;
+        };
+
+        for (auto& piece : pieces_)
+            remap(piece);
+
+        for (auto& step : steps_) {
+            for (auto& edit : step.edits) {
+                for (auto& piece : edit.removed)
+                    remap(piece);
+                remap(edit.inserted);
+            }
+        }
+
+        added_ = added;
+
+        // Typing merges check buffer contiguity, which remapping can break
+        mergeable_ = false;
+    }
+
+    bool isMergeable_(const Edit_& edit) const
+    {
+        auto removed = lengthOf_(edit.removed);
+        auto added = edit.inserted.length;
+
+        // Single-character insert or delete
+        if (added + removed != 1) return false;
+
+        auto text = added ? viewOf_(edit.inserted) : viewOf_(edit.removed[0]);
+        return text.front() != QChar('\n');
+    }
+
+    bool tryMerge_(const Edit_& edit)
+    {
+        if (!mergeable_ || groupDepth_ > 0 || stepIndex_ != steps_.size())
+            return false;
+
+        if (!isMergeable_(edit)) return false;
+
+        auto& last = steps_[stepIndex_ - 1].edits.last();
+        auto last_removed = lengthOf_(last.removed);
+
+        // Typing: the insert continues the last one, in the buffer too
+        if (edit.inserted.length && last.inserted.length && !last_removed
+            && edit.pos == last.pos + last.inserted.length
+            && edit.inserted.start
+                   == last.inserted.start + last.inserted.length) {
+            last.inserted.length += edit.inserted.length;
+            return true;
+        }
+
+        if (edit.inserted.length || last.inserted.length) return false;
+
+        // Backspace: the removal ends where the last one began
+        if (edit.pos + 1 == last.pos) {
+            last.removed = edit.removed + last.removed;
+            last.pos = edit.pos;
+            return true;
+        }
+
+        // Delete: the removal begins where the last one did
+        if (edit.pos == last.pos) {
+            last.removed += edit.removed;
+            return true;
+        }
+
+        return false;
+    }
+};
+
+} // namespace Hearth
@@ -0,0 +1,443 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <functional>
+
+#include <QByteArray>
+#include <QChar>
+#include <QIODevice>
+#include <QList>
+#include <QObject>
+#include <QPlainTextDocumentLayout>
+#include <QString>
+#include <QStringTokenizer>
+#include <QStringView>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "core/Debug.h"
+#include "models/PieceTable.h"
+
+namespace Hearth {
+
+using namespace Qt::StringLiterals;
+
+/// TODO PD
+// The authoritative copy of a TextFileModel's content, and the owner of its
+// undo/redo history (see PrimeDocument.md). Undo and redo return the changes
+// they made as deltas, which the model routes to view documents
+class PrimeStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Delta = PieceTable::Delta;
+
+    // Return false to stop
+    using LineVisitor = std::function<bool(const QString& line)>;
+
+    explicit PrimeStore(QObject* parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+    virtual ~PrimeStore() override = default;
+
+    virtual QString text() const = 0;
+    virtual int length() const = 0;
+    virtual QString mid(int pos, int count) const = 0;
+
+    // Clears undo history
+    virtual void setText(const QString& text) = 0;
+
+    virtual void replace(int pos, int removed, const QString& added) = 0;
+
+    // Edits between begin and end undo as one step
+    virtual void beginGroup() = 0;
+    virtual void endGroup() = 0;
+
+    virtual bool canUndo() const = 0;
+    virtual bool canRedo() const = 0;
+    virtual QList<Delta> undo() = 0;
+    virtual QList<Delta> redo() = 0;
+
+    virtual bool isModified() const = 0;
+    virtual void setModified(bool modified) = 0;
+
+    // Bounds the memory undo history holds (0 is unbounded). Stores that
+    // can't bound their history ignore it
+    virtual void setUndoBudget([[maybe_unused]] qint64 bytes) {}
+
+    virtual QByteArray toUtf8() const = 0;
+
+    virtual bool writeUtf8(QIODevice& device) const
+    {
+        auto bytes = toUtf8();
+        return device.write(bytes) == bytes.size();
+    }
+
+    virtual void forEachLine(const LineVisitor& visitor) const = 0;
+
+    // Text of [pos, pos + count) in doc, with '\n' line breaks. Reads blocks
+    // directly rather than selecting with a QTextCursor, so the only copy made
+    // is the result (plus the first and last blocks' text, for a multi-block
+    // range)
+    static QString extractText(QTextDocument* doc, int pos, int count)
+    {
+        if (!doc || count <= 0) return {};
+
+        auto max_pos = doc->characterCount() - 1;
+        if (pos >= max_pos) return {};
+        count = qMin(count, max_pos - pos);
+
+        // Typing
+        if (count == 1)
+            return QString(lineBreakToNewline_(doc->characterAt(pos)));
+
+        QString text{};
+        text.reserve(count);
+
+        // QTextBlock::text() excludes the block's paragraph separator, which
+        // is added back as '\n' (QTextCursor::insertText() treats '\n' as a
+        // paragraph break)
+        for (auto block = doc->findBlock(pos); block.isValid();
+             block = block.next()) {
+            auto block_text = block.text();
+            auto offset = qMax(pos - block.position(), 0);
+            auto take = qMin(block_text.size() - offset, count - text.size());
+
+            text += QStringView(block_text).sliced(offset, take);
+            if (text.size() >= count) break;
+
+            text += QChar('\n');
+            if (text.size() >= count) break;
+        }
+
+        return text;
+
+        // If the above doesn't work (but this is not ideal):
+        // return doc->toPlainText().mid(pos, count);
+    }
+
+    // Applies a delta with the given cursor, which may be kept and reused
+    // (see TextFileModel::ViewDocument_)
+    static void applyDelta(
+        QTextCursor& cursor,
+        int pos,
+        int removed,
+        const QString& added)
+    {
+        auto doc = cursor.document();
+        if (!doc) return;
+
+        // characterCount() includes the trailing paragraph separator;
+        // the last valid cursor position is one before it
+        auto max_pos = doc->characterCount() - 1;
+
+        cursor.setPosition(qMin(pos, max_pos));
+
+        if (removed > 0)
+            cursor.setPosition(
+                qMin(pos + removed, max_pos),
+                QTextCursor::KeepAnchor);
+
+        cursor.insertText(added);
+    }
+
+signals:
+    void modificationChanged(bool modified);
+    void undoAvailable(bool available);
+    void redoAvailable(bool available);
+    void contentsChanged();
+
+private:
+    static QChar lineBreakToNewline_(QChar ch) noexcept
+    {
+        return ch == QChar::ParagraphSeparator ? QChar('\n') : ch;
+    }
+};
+
+// The original prime store: a QTextDocument, with Qt's own undo stack. Qt
+// can only clear that stack whole, so the undo budget doesn't apply
+class DocumentPrimeStore : public PrimeStore
+{
+    Q_OBJECT
+
+public:
+    explicit DocumentPrimeStore(QObject* parent = nullptr)
+        : PrimeStore(parent)
+    {
+        setup_();
+    }
+
+    virtual ~DocumentPrimeStore() override { TRACER; }
+
+    virtual QString text() const override { return document_->toPlainText(); }
+
+    virtual int length() const override
+    {
+        return document_->characterCount() - 1;
+    }
+
+    virtual QString mid(int pos, int count) const override
+    {
+        return extractText(document_, pos, count);
+    }
+
+    virtual void setText(const QString& text) override
+    {
+        document_->setPlainText(text);
+    }
+
+    virtual void replace(int pos, int removed, const QString& added) override
+    {
+        applyDelta(cursor_, pos, removed, added);
+    }
+
+    virtual void beginGroup() override
+    {
+        editBlockCursor_ = QTextCursor(document_);
+        editBlockCursor_.beginEditBlock();
+    }
+
+    virtual void endGroup() override
+    {
+        if (editBlockCursor_.isNull()) return;
+        editBlockCursor_.endEditBlock();
+        editBlockCursor_ = QTextCursor{}; // release
+    }
+
+    virtual bool canUndo() const override
+    {
+        return document_->isUndoAvailable();
+    }
+
+    virtual bool canRedo() const override
+    {
+        return document_->isRedoAvailable();
+    }
+
+    virtual QList<Delta> undo() override
+    {
+        return capture_([this] { document_->undo(); });
+    }
+
+    virtual QList<Delta> redo() override
+    {
+        return capture_([this] { document_->redo(); });
+    }
+
+    virtual bool isModified() const override { return document_->isModified(); }
+
+    virtual void setModified(bool modified) override
+    {
+        document_->setModified(modified);
+    }
+
+    virtual QByteArray toUtf8() const override
+    {
+        return document_->toPlainText().toUtf8();
+    }
+
+    virtual void forEachLine(const LineVisitor& visitor) const override
+    {
+        for (auto block = document_->begin(); block.isValid();
+             block = block.next())
+            if (!visitor(block.text())) return;
+    }
+
+private:
+    QTextDocument* document_ = new QTextDocument(this);
+    QTextCursor cursor_{ document_ };
+    QTextCursor editBlockCursor_{};
+
+    void setup_()
+    {
+        auto layout = new QPlainTextDocumentLayout(document_);
+        document_->setDocumentLayout(layout);
+
+        connect(
+            document_,
+            &QTextDocument::modificationChanged,
+            this,
+            &PrimeStore::modificationChanged);
+
+        connect(
+            document_,
+            &QTextDocument::undoAvailable,
+            this,
+            &PrimeStore::undoAvailable);
+
+        connect(
+            document_,
+            &QTextDocument::redoAvailable,
+            this,
+            &PrimeStore::redoAvailable);
+
+        connect(
+            document_,
+            &QTextDocument::contentsChange,
+            this,
+            &PrimeStore::contentsChanged);
+    }
+
+    // Records the changes an undo/redo makes. Text is extracted as each
+    // change happens, since later changes in the same step shift positions
+    template <typename OperationT> QList<Delta> capture_(OperationT&& operation)
+    {
+        QList<Delta> deltas{};
+
+        auto conn = connect(
+            document_,
+            &QTextDocument::contentsChange,
+            this,
+            [this, &deltas](int pos, int removed, int added) {
+                deltas << Delta{ pos,
+                                 removed,
+                                 extractText(document_, pos, added) };
+            });
+
+        operation();
+        disconnect(conn);
+
+        return deltas;
+    }
+};
+
+// Piece table prime store (see PieceTable). Edits and undo/redo never copy
+// the document, and saving transcodes piece by piece straight to the device
+class PieceTablePrimeStore : public PrimeStore
+{
+    Q_OBJECT
+
+public:
+    explicit PieceTablePrimeStore(QObject* parent = nullptr)
+        : PrimeStore(parent)
+    {
+    }
+
+    virtual ~PieceTablePrimeStore() override { TRACER; }
+
+    virtual QString text() const override { return table_.text(); }
+    virtual int length() const override { return int(table_.length()); }
+
+    virtual QString mid(int pos, int count) const override
+    {
+        return table_.mid(pos, count);
+    }
+
+    virtual void setText(const QString& text) override
+    {
+        auto states = states_();
+
+        // Match what QTextDocument::setPlainText makes of line breaks, so
+        // positions agree with view documents
+        auto normalized = text;
+        normalized.replace(u"\r\n"_s, u"\n"_s);
+        normalized.replace(QChar('\r'), QChar('\n'));
+        normalized.replace(QChar::ParagraphSeparator, QChar('\n'));
+
+        table_.reset(normalized);
+        notify_(states);
+    }
+
+    virtual void replace(int pos, int removed, const QString& added) override
+    {
+        auto states = states_();
+        table_.replace(pos, removed, added);
+        notify_(states);
+    }
+
+    virtual void beginGroup() override { table_.beginGroup(); }
+    virtual void endGroup() override { table_.endGroup(); }
+
+    virtual bool canUndo() const override { return table_.canUndo(); }
+    virtual bool canRedo() const override { return table_.canRedo(); }
+
+    virtual QList<Delta> undo() override
+    {
+        auto states = states_();
+        auto deltas = table_.undo();
+        notify_(states);
+        return deltas;
+    }
+
+    virtual QList<Delta> redo() override
+    {
+        auto states = states_();
+        auto deltas = table_.redo();
+        notify_(states);
+        return deltas;
+    }
+
+    virtual bool isModified() const override { return table_.isModified(); }
+
+    virtual void setModified(bool modified) override
+    {
+        auto states = states_();
+        table_.setModified(modified);
+        notify_(states, false);
+    }
+
+    virtual void setUndoBudget(qint64 bytes) override
+    {
+        auto states = states_();
+        table_.setUndoBudget(bytes / qint64(sizeof(QChar)));
+        notify_(states, false);
+    }
+
+    virtual QByteArray toUtf8() const override { return table_.toUtf8(); }
+
+    virtual bool writeUtf8(QIODevice& device) const override
+    {
+        return table_.writeUtf8(device);
+    }
+
+    virtual void forEachLine(const LineVisitor& visitor) const override
+    {
+        auto text = table_.text();
+
+        for (auto line : QStringTokenizer{ text, u'\n' })
+            if (!visitor(line.toString())) return;
+    }
+
+private:
+    PieceTable table_{};
+
+    struct States_
+    {
+        bool modified;
+        bool undo;
+        bool redo;
+    };
+
+    States_ states_() const
+    {
+        return { table_.isModified(), table_.canUndo(), table_.canRedo() };
+    }
+
+    void notify_(const States_& before, bool contentsChanged = true)
+    {
+        auto after = states_();
+
+        if (before.modified != after.modified)
+            emit modificationChanged(after.modified);
+        if (before.undo != after.undo) emit undoAvailable(after.undo);
+        if (before.redo != after.redo) emit redoAvailable(after.redo);
+        if (contentsChanged) emit this->contentsChanged();
+    }
+};
+
+} // namespace Hearth
@@ -13,11 +13,11 @@
 #pragma once
 
 #include <QByteArray>
-#include <QChar>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QList>
 #include <QObject>
-#include <QPlainTextDocumentLayout>
 #include <QString>
-#include <QTextBlock>
 #include <QTextCursor>
 #include <QTextDocument>
 
@@ -25,21 +25,45 @@
 
 #include "core/Debug.h"
 #include "core/Files.h"
+#include "core/Time.h"
 #include "core/Version.h"
 #include "models/AbstractFileModel.h"
 #include "models/FileMeta.h"
+#include "models/PrimeStore.h"
 
 namespace Hearth {
 
 using namespace Qt::StringLiterals;
 
-// Text document implementation using QTextDocument (editing, undo/redo, and
+// Text document implementation over a PrimeStore (editing, undo/redo, and
 // modification tracking). Provides automatic title generation for unsaved files
 class TextFileModel : public AbstractFileModel
 {
     Q_OBJECT
 
 public:
+    // The prime store's backing. Document is a QTextDocument; PieceTable
+    // keeps edits and undo history as pieces, which is cheaper for very large
+    // files (see PrimeDocument.md)
+    enum class Storage
+    {
+        Document,
+        PieceTable
+    };
+
+    // On-disk files at least this large open with Storage::PieceTable
+    static constexpr qint64 PIECE_TABLE_MIN_BYTES = 1024 * 1024;
+
+    static Storage storageFor(qint64 bytes) noexcept
+    {
+        return bytes >= PIECE_TABLE_MIN_BYTES ? Storage::PieceTable
+                                              : Storage::Document;
+    }
+
+    // Data at least this large loads into view documents incrementally (see
+    // setData)
+    static constexpr qint64 LARGE_FILE_MIN_BYTES = 8 * 1024 * 1024;
+
     // AbstractFileModel takes both a Files::Type and a path. Type drives view
     // selection and fallback extension; path drives display title and on-disk
     // status. Siblings (PdfFileModel, ImageFileModel) resolve Type differently
@@ -47,17 +71,20 @@ public:
     // the base level
 
     // On-disk: File type derived from path extension
-    explicit TextFileModel(const Coco::Path& path, QObject* parent = nullptr)
+    explicit TextFileModel(
+        const Coco::Path& path,
+        Storage storage,
+        QObject* parent = nullptr)
         : AbstractFileModel(Files::fromPath(path), path, parent)
     {
-        setup_();
+        setup_(storage);
     }
 
     // Off-disk (new, unsaved): File type explicit, no path
     explicit TextFileModel(Files::Type fileType, QObject* parent = nullptr)
         : AbstractFileModel(fileType, {}, parent)
     {
-        setup_();
+        setup_(Storage::Document);
     }
 
     virtual ~TextFileModel() override { TRACER; }
@@ -68,15 +95,17 @@ public:
     /// TODO PD
     void registerViewDocument(QTextDocument* viewDoc)
     {
-        if (!viewDoc || localViewDocuments_.contains(viewDoc)) return;
+        if (!viewDoc || indexOfView_(viewDoc) > -1) return;
 
-        localViewDocuments_ << viewDoc;
+        localViewDocuments_ << ViewDocument_{ viewDoc, QTextCursor(viewDoc) };
         viewDoc->setUndoRedoEnabled(false);
 
-        // Initialize content from prime
+        // Initialize content from prime (while loading, only what the other
+        // views have so far; the rest arrives with theirs)
         {
             DeltaRoutingScope_ scope(routingDelta_);
-            viewDoc->setPlainText(primeDocument_->toPlainText());
+            viewDoc->setPlainText(
+                loading_ ? prime_->mid(0, loaded_) : prime_->text());
         }
 
         connect(
@@ -88,13 +117,15 @@ public:
             });
 
         connect(viewDoc, &QObject::destroyed, this, [this, viewDoc] {
-            localViewDocuments_.removeAll(viewDoc);
+            removeView_(viewDoc);
         });
 
         INFO(
             "Local view document registered [{}], total views: {}",
             viewDoc,
             localViewDocuments_.size());
+
+        if (loading_) scheduleLoad_();
     }
 
     /// TODO PD
@@ -102,94 +133,162 @@ public:
     {
         if (!viewDoc) return;
         viewDoc->disconnect(this);
-        localViewDocuments_.removeAll(viewDoc);
+        removeView_(viewDoc);
     }
 
     /// TODO PD
     // Call before a sequence of edits that should undo/redo as one step.
-    // This opens an edit block on the prime doc so that deltas arriving
-    // from a view are grouped into a single undo operation
+    // This opens a group on the prime store so that deltas arriving from a
+    // view are grouped into a single undo operation
     void beginCompoundEdit()
     {
-        if (!primeDocument_) return;
-        primeDocumentEditBlockCursor_ = QTextCursor(primeDocument_);
-        primeDocumentEditBlockCursor_.beginEditBlock();
+        if (!prime_) return;
+        prime_->beginGroup();
     }
 
     /// TODO PD
     void endCompoundEdit()
     {
-        if (primeDocumentEditBlockCursor_.isNull()) return;
-        primeDocumentEditBlockCursor_.endEditBlock();
-        primeDocumentEditBlockCursor_ = QTextCursor{}; // release
+        if (!prime_) return;
+        prime_->endGroup();
     }
 
     void insertContent(const QString& text)
     {
-        if (!primeDocument_ || text.isEmpty()) return;
-        QTextCursor cursor(primeDocument_);
-        cursor.insertText(text);
+        if (!prime_ || text.isEmpty()) return;
+
+        flushPendingDeltas();
+
+        DeltaRoutingScope_ scope(routingDelta_);
+        prime_->replace(0, 0, text);
+        routeDelta_(nullptr, 0, 0, text);
+        shiftLoaded_(0, text.size());
+        assertSync_(__FUNCTION__);
     }
 
-    virtual QByteArray data() const override
+    virtual QByteArray data() const override { return prime_->toUtf8(); }
+
+    // Streams from the prime store, which (for Storage::PieceTable) never
+    // assembles the whole document
+    virtual bool write(QIODevice& device) const override
     {
-        return primeDocument_->toPlainText().toUtf8();
+        return prime_ && prime_->writeUtf8(device);
     }
 
     /// TODO PD
+    // Large data (see LARGE_FILE_MIN_BYTES) goes to the prime at once but
+    // reaches view documents in slices across event loop turns, so the window
+    // stays responsive and views show the start of the file right away. Each
+    // slice is extracted once from the prime and appended to every view.
+    // Editing the loaded part meanwhile is fine: the unloaded remainder is
+    // always the prime's tail
     virtual void setData(const QByteArray& data) override
     {
-        if (!primeDocument_) return;
+        if (!prime_) return;
 
         DeltaRoutingScope_ scope(routingDelta_);
-        primeDocument_->setPlainText(QString::fromUtf8(data));
+        prime_->setText(QString::fromUtf8(data));
+
+        // Views are rebuilt below, so anything queued for them is moot
+        for (auto& view : localViewDocuments_)
+            view.pending.clear();
 
-        auto prime_text = primeDocument_->toPlainText();
-        for (auto& view_doc : localViewDocuments_)
-            view_doc->setPlainText(prime_text);
+        if (data.size() >= LARGE_FILE_MIN_BYTES) {
+            for (auto& view : localViewDocuments_)
+                view.document->clear();
+
+            loaded_ = 0;
+            setLoading_(true);
+            scheduleLoad_();
+            return;
+        }
+
+        setLoading_(false);
+
+        auto prime_text = prime_->text();
+        for (auto& view : localViewDocuments_)
+            view.document->setPlainText(prime_text);
 
         assertSync_(__FUNCTION__);
     }
 
-    virtual bool isUserEditable() const override { return primeDocument_; }
+    // True while view documents are still receiving large data
+    bool isLoading() const noexcept { return loading_; }
+
+    /// TODO PD
+    // Applies deltas queued for views now rather than on the next tick. Views
+    // call this when their editor gains focus, so a view is never edited
+    // while behind
+    void flushPendingDeltas()
+    {
+        if (routingDelta_) return;
+
+        DeltaRoutingScope_ scope(routingDelta_);
+        auto flushed = false;
+
+        for (auto& view : localViewDocuments_) {
+            if (view.pending.isEmpty() || view.resyncCursorPos > -1) continue;
+
+            for (auto& delta : view.pending)
+                PrimeStore::applyDelta(
+                    view.cursor,
+                    int(delta.pos),
+                    int(delta.removed),
+                    delta.added);
+
+            view.pending.clear();
+            flushed = true;
+        }
+
+        if (flushed) assertSync_(__FUNCTION__);
+    }
+
+    // Memory that undo history may hold before older steps spill to disk (0
+    // is unbounded). See PrimeStore::setUndoBudget
+    void setUndoBudget(qint64 bytes)
+    {
+        if (prime_) prime_->setUndoBudget(bytes);
+    }
+
+    virtual bool isUserEditable() const override { return prime_; }
 
     virtual bool hasUndo() const override
     {
-        return primeDocument_ && primeDocument_->isUndoAvailable();
+        return prime_ && prime_->canUndo();
     }
 
     virtual bool hasRedo() const override
     {
-        return primeDocument_ && primeDocument_->isRedoAvailable();
+        return prime_ && prime_->canRedo();
     }
 
     /// TODO PD
     virtual void undo() override
     {
-        if (!primeDocument_ || routingDelta_) return;
-        replayPrimeOperation_([this] { primeDocument_->undo(); });
+        if (!prime_ || routingDelta_) return;
+        replayPrimeOperation_(prime_->undo());
     }
 
     /// TODO PD
     virtual void redo() override
     {
-        if (!primeDocument_ || routingDelta_) return;
-        replayPrimeOperation_([this] { primeDocument_->redo(); });
+        if (!prime_ || routingDelta_) return;
+        replayPrimeOperation_(prime_->redo());
     }
 
     virtual bool isModified() const override
     {
-        return primeDocument_ && primeDocument_->isModified();
+        return prime_ && prime_->isModified();
     }
 
     virtual void setModified(bool modified) override
     {
-        if (primeDocument_) primeDocument_->setModified(modified);
+        if (prime_) prime_->setModified(modified);
     }
 
 signals:
     // Undo/redo on the prime document reaches view documents as manual
-    // applyDelta_ calls via throwaway cursors. The editor's visible cursor is a
+    // applyDelta calls via routing cursors. The editor's visible cursor is a
     // separate object that Qt only auto-positions during native undo on the
     // editor's own document. Since views never see a native undo (just an
     // incoming text edit) the editor has no reason to move its cursor to the
@@ -200,10 +299,13 @@ signals:
     // previously-focused widget before the action's triggered() signal fires
     void cursorPositionHint(int position);
 
+    // 0-100 while loading large data into view documents (see setData)
+    void loadProgressChanged(int percent);
+
 private:
     /// TODO PD
     // When View A types a character, the model receives the contentsChange and
-    // calls applyDelta_ on the prime doc and View B's local doc. But applying a
+    // applies it to the prime and View B's local doc. But applying a
     // delta to View B's doc causes View B's doc to also fire contentsChange.
     // Without routingDelta_, that signal would re-enter
     // onLocalViewContentsChange_, which would try to apply the delta to the
@@ -226,42 +328,148 @@ private:
         DeltaRoutingScope_& operator=(const DeltaRoutingScope_&) = delete;
     };
 
-    QTextDocument* primeDocument_ = new QTextDocument(this);
-    QList<QTextDocument*> localViewDocuments_{};
-    QTextCursor primeDocumentEditBlockCursor_{};
+    /// TODO PD
+    // Each view doc keeps one cursor for applying routed deltas, rather than
+    // constructing one per delta, and a queue of deltas it hasn't received yet
+    // (see queueDelta_)
+    struct ViewDocument_
+    {
+        QTextDocument* document = nullptr;
+        QTextCursor cursor{};
+        QList<PrimeStore::Delta> pending{};
+        int resyncCursorPos = -1; // Rebuilt from the prime on the next tick
+    };
+
+    PrimeStore* prime_ = nullptr;
+    QList<ViewDocument_> localViewDocuments_{};
+
+    static constexpr auto LOAD_CHUNK_CHARS_ = 64 * 1024;
+    static constexpr auto LOAD_SLICE_MSECS_ = 12;
+
+    bool loading_ = false;
+    bool loadScheduled_ = false;
+    int loaded_ = 0; // Prime chars present in view documents
+
+    bool flushScheduled_ = false;
+
+    int indexOfView_(QTextDocument* viewDoc) const
+    {
+        for (auto i = 0; i < localViewDocuments_.size(); ++i)
+            if (localViewDocuments_[i].document == viewDoc) return i;
+
+        return -1;
+    }
+
+    void removeView_(QTextDocument* viewDoc)
+    {
+        auto i = indexOfView_(viewDoc);
+        if (i > -1) localViewDocuments_.removeAt(i);
+
+        // The next view to register starts the load over, incrementally,
+        // instead of receiving everything loaded so far at once
+        if (loading_ && localViewDocuments_.isEmpty()) loaded_ = 0;
+    }
+
+    void setLoading_(bool loading)
+    {
+        if (loading_ == loading) return;
+        loading_ = loading;
+        emit loadProgressChanged(loading ? 0 : 100);
+    }
+
+    // Loading waits for a view. Without one, there's nothing to load into
+    void scheduleLoad_()
+    {
+        if (loadScheduled_ || localViewDocuments_.isEmpty()) return;
+
+        loadScheduled_ = true;
+        Time::onNextTick(this, [this] {
+            loadScheduled_ = false;
+            loadSlice_();
+        });
+    }
+
+    void loadSlice_()
+    {
+        if (!loading_ || localViewDocuments_.isEmpty()) return;
+
+        // Queued deltas may sit at the load boundary
+        flushPendingDeltas();
+
+        DeltaRoutingScope_ scope(routingDelta_);
+        auto total = prime_->length();
+        QElapsedTimer timer{};
+        timer.start();
+
+        while (loaded_ < total && timer.elapsed() < LOAD_SLICE_MSECS_) {
+            auto chunk = prime_->mid(loaded_, LOAD_CHUNK_CHARS_);
+
+            // Don't split a surrogate pair between chunks
+            if (!chunk.isEmpty() && chunk.back().isHighSurrogate())
+                chunk += prime_->mid(loaded_ + chunk.size(), 1);
+
+            for (auto& view : localViewDocuments_) {
+                view.cursor.movePosition(QTextCursor::End);
+                view.cursor.insertText(chunk);
+            }
+
+            loaded_ += chunk.size();
+        }
+
+        if (loaded_ < total) {
+            emit loadProgressChanged(int(qint64(loaded_) * 100 / total));
+            scheduleLoad_();
+            return;
+        }
+
+        setLoading_(false);
+        assertSync_(__FUNCTION__);
+    }
+
+    // Keeps the load boundary in place when the loaded part is edited
+    void shiftLoaded_(int removed, int added)
+    {
+        if (loading_) loaded_ += added - removed;
+    }
 
-    void setup_()
+    void setup_(Storage storage)
     {
-        auto layout = new QPlainTextDocumentLayout(primeDocument_);
-        primeDocument_->setDocumentLayout(layout);
+        if (storage == Storage::PieceTable)
+            prime_ = new PieceTablePrimeStore(this);
+        else
+            prime_ = new DocumentPrimeStore(this);
 
         connect(
-            primeDocument_,
-            &QTextDocument::modificationChanged,
+            prime_,
+            &PrimeStore::modificationChanged,
             this,
             [this](bool changed) { emit modificationChanged(changed); });
 
         connect(
-            primeDocument_,
-            &QTextDocument::undoAvailable,
+            prime_,
+            &PrimeStore::undoAvailable,
             this,
             [this](bool available) { emit undoAvailable(available); });
 
         connect(
-            primeDocument_,
-            &QTextDocument::redoAvailable,
+            prime_,
+            &PrimeStore::redoAvailable,
             this,
             [this](bool available) { emit redoAvailable(available); });
 
         connect(
-            primeDocument_,
-            &QTextDocument::contentsChange,
+            prime_,
+            &PrimeStore::contentsChanged,
             this,
-            &TextFileModel::onDocumentContentsChange_);
+            &TextFileModel::onPrimeContentsChanged_);
     }
 
     /// TODO PD
-    // A view's local doc changed. Route the delta to prime and other views
+    // A view's local doc changed. Route the delta to prime and other views.
+    // The added text is extracted once and shared (QString is implicitly
+    // shared) by the prime and every view it's applied to. Other views get it
+    // on the next tick (see queueDelta_), so a burst of typing costs them one
+    // relayout per frame rather than one per keystroke
     void onLocalViewContentsChange_(
         QTextDocument* source,
         int pos,
@@ -271,90 +479,180 @@ private:
         if (routingDelta_) return;
 
         DeltaRoutingScope_ scope(routingDelta_);
-        auto added_text = extractText_(source, pos, added);
+        auto added_text = PrimeStore::extractText(source, pos, added);
+
+        // A view edited while behind (it should have been flushed when its
+        // editor gained focus). Its positions predate the queued deltas, so
+        // map them forward, then rebuild it from the prime. Not here, though:
+        // the view is still emitting this change
+        auto i = indexOfView_(source);
+        if (i > -1
+            && (!localViewDocuments_[i].pending.isEmpty()
+                || localViewDocuments_[i].resyncCursorPos > -1)) {
+            auto& view = localViewDocuments_[i];
+            WARN("View document [{}] edited with queued deltas!", source);
+
+            auto end = mapPosition_(pos + removed, view.pending);
+            pos = mapPosition_(pos, view.pending);
+            removed = qMax(end - pos, 0);
+
+            prime_->replace(pos, removed, added_text);
+            queueDelta_(source, pos, removed, added_text);
+            shiftLoaded_(removed, added_text.size());
+            scheduleResync_(view, pos + added_text.size());
+            return;
+        }
 
-        applyDelta_(primeDocument_, pos, removed, added_text);
-        routeDelta_(source, pos, removed, added_text);
-        assertSync_(__FUNCTION__);
+        prime_->replace(pos, removed, added_text);
+        queueDelta_(source, pos, removed, added_text);
+        shiftLoaded_(removed, added_text.size());
     }
 
     /// TODO PD
-    // Replay a prime doc operation (undo/redo) to all view docs
-    template <typename OperationT>
-    void replayPrimeOperation_(OperationT&& operation)
+    // Queues a delta for every view but the source, merging it into the last
+    // queued delta where it continues it (typing, backspacing, or deleting)
+    void queueDelta_(
+        QTextDocument* source,
+        int pos,
+        int removed,
+        const QString& addedText)
     {
-        DeltaRoutingScope_ scope(routingDelta_);
-        auto hint_pos = -1;
+        for (auto& view : localViewDocuments_) {
+            if (view.document == source) continue;
 
-        // TODO: hint_pos reflects the LAST contentsChange during a compound
-        // undo/redo. For adjacent edits (auto-close, barge, delete-pair) it's
-        // fine. If a future compound edit spans distant positions, the cursor
-        // hint may land at the wrong site. A fix might be to track all delta
-        // positions and pick the most useful one (e.g., earliest)
+            auto& pending = view.pending;
 
-        auto conn = connect(
-            primeDocument_,
-            &QTextDocument::contentsChange,
-            this,
-            [this, &hint_pos](int pos, int removed, int added) {
-                auto text = extractText_(primeDocument_, pos, added);
-                routeDelta_(nullptr, pos, removed, text);
-                hint_pos = pos + text.length();
-            });
+            if (!pending.isEmpty()
+                && mergeDelta_(pending.last(), pos, removed, addedText))
+                continue;
 
-        operation();
-        disconnect(conn);
-        if (hint_pos >= 0) emit cursorPositionHint(hint_pos);
-        assertSync_(__FUNCTION__);
+            pending << PrimeStore::Delta{ pos, removed, addedText };
+        }
+
+        if (flushScheduled_) return;
+
+        flushScheduled_ = true;
+        Time::onNextTick(this, [this] {
+            flushScheduled_ = false;
+            flushPendingDeltas();
+        });
     }
 
-    /// TODO PD
-    QString extractText_(QTextDocument* doc, int pos, int count)
+    static bool mergeDelta_(
+        PrimeStore::Delta& last,
+        int pos,
+        int removed,
+        const QString& addedText)
     {
-        if (count <= 0) return {};
+        auto last_end = last.pos + last.added.size();
+
+        // Insert continuing an insert
+        if (removed == 0 && pos == last_end) {
+            last.added += addedText;
+            return true;
+        }
+
+        if (!addedText.isEmpty()) return false;
 
-        auto max_pos = doc->characterCount() - 1;
-        if (pos >= max_pos) return {};
+        // Backspace over text the last inserted
+        if (pos >= last.pos && pos + removed == last_end) {
+            last.added.chop(removed);
+            return true;
+        }
 
-        QTextCursor cursor(doc);
-        cursor.setPosition(pos);
-        cursor.setPosition(qMin(pos + count, max_pos), QTextCursor::KeepAnchor);
+        if (!last.added.isEmpty()) return false;
 
-        // QTextCursor::selectedText() returns paragraph breaks as
-        // QChar::ParagraphSeparator (U+2029). We convert to '\n' because
-        // QTextCursor::insertText() treats '\n' as a paragraph break. If Qt
-        // ever changed how insertText handles '\n' vs ParagraphSeparator, the
-        // fallback below (toPlainText().mid()) is immune at O(N) cost
+        // Backspace: the removal ends where the last began
+        if (pos + removed == last.pos) {
+            last.pos = pos;
+            last.removed += removed;
+            return true;
+        }
 
-        auto text = cursor.selectedText();
-        text.replace(QChar::ParagraphSeparator, QChar('\n'));
-        return text;
+        // Delete: the removal begins where the last did
+        if (pos == last.pos) {
+            last.removed += removed;
+            return true;
+        }
 
-        // If the above doesn't work (but this is not ideal):
-        // if (count <= 0) return {};
-        // return doc->toPlainText().mid(pos, count);
+        return false;
+    }
+
+    // Maps a position in a document that hasn't received deltas to where it
+    // is once they've been applied
+    static int mapPosition_(int pos, const QList<PrimeStore::Delta>& deltas)
+    {
+        for (auto& delta : deltas) {
+            auto delta_pos = int(delta.pos);
+            auto delta_end = delta_pos + int(delta.removed);
+            auto added = int(delta.added.size());
+
+            if (pos <= delta_pos) continue;
+
+            if (pos >= delta_end)
+                pos += added - int(delta.removed);
+            else
+                pos = delta_pos + added;
+        }
+
+        return pos;
+    }
+
+    // Until then, the view's queued deltas stay put (so further edits to it
+    // map forward the same way) and aren't flushed into it
+    void scheduleResync_(ViewDocument_& view, int cursorPos)
+    {
+        auto scheduled = view.resyncCursorPos > -1;
+        view.resyncCursorPos = cursorPos;
+        if (scheduled) return;
+
+        Time::onNextTick(this, [this, document = view.document] {
+            auto i = indexOfView_(document);
+            if (i > -1) resyncView_(localViewDocuments_[i]);
+        });
+    }
+
+    void resyncView_(ViewDocument_& view)
+    {
+        DeltaRoutingScope_ scope(routingDelta_);
+        auto cursor_pos = view.resyncCursorPos;
+
+        view.pending.clear();
+        view.resyncCursorPos = -1;
+        view.document->setPlainText(
+            loading_ ? prime_->mid(0, loaded_) : prime_->text());
+
+        // Put the editor's cursor back where the edit happened. The editor's
+        // cursor is the one QPlainTextEdit keeps, so hint rather than reach it
+        emit cursorPositionHint(cursor_pos);
+        assertSync_(__FUNCTION__);
     }
 
     /// TODO PD
-    void applyDelta_(
-        QTextDocument* doc,
-        int pos,
-        int removed,
-        const QString& addedText)
+    // Replay the changes of a prime undo/redo to all view docs
+    void replayPrimeOperation_(const QList<PrimeStore::Delta>& deltas)
     {
-        // characterCount() includes the trailing paragraph separator;
-        // the last valid cursor position is one before it
-        auto max_pos = doc->characterCount() - 1;
+        // The focused view needs the hint against current text
+        flushPendingDeltas();
 
-        QTextCursor cursor(doc);
-        cursor.setPosition(qMin(pos, max_pos));
+        DeltaRoutingScope_ scope(routingDelta_);
+        auto hint_pos = -1;
 
-        if (removed > 0)
-            cursor.setPosition(
-                qMin(pos + removed, max_pos),
-                QTextCursor::KeepAnchor);
+        // TODO: hint_pos reflects the LAST delta of a compound undo/redo. For
+        // adjacent edits (auto-close, barge, delete-pair) it's fine. If a
+        // future compound edit spans distant positions, the cursor hint may
+        // land at the wrong site. A fix might be to track all delta positions
+        // and pick the most useful one (e.g., earliest)
+
+        for (auto& delta : deltas) {
+            auto pos = int(delta.pos);
+            routeDelta_(nullptr, pos, int(delta.removed), delta.added);
+            shiftLoaded_(int(delta.removed), delta.added.size());
+            hint_pos = pos + delta.added.length();
+        }
 
-        cursor.insertText(addedText);
+        if (hint_pos >= 0) emit cursorPositionHint(hint_pos);
+        assertSync_(__FUNCTION__);
     }
 
     /// TODO PD
@@ -364,9 +662,12 @@ private:
         int removed,
         const QString& addedText)
     {
-        for (auto* view_doc : localViewDocuments_) {
-            if (view_doc != exclude)
-                applyDelta_(view_doc, pos, removed, addedText);
+        for (auto& view : localViewDocuments_) {
+            // Views awaiting a resync get the prime whole
+            if (view.document == exclude || view.resyncCursorPos > -1)
+                continue;
+
+            PrimeStore::applyDelta(view.cursor, pos, removed, addedText);
         }
     }
 
@@ -375,9 +676,19 @@ private:
     {
 #ifdef VERSION_DEBUG
 
-        auto prime_text = primeDocument_->toPlainText();
+        // Views only hold part of the prime until loading finishes
+        if (loading_) return;
+
+        // QTextDocument::toPlainText() turns non-breaking spaces into spaces,
+        // but a PieceTable prime keeps them
+        auto prime_text = prime_->text();
+        prime_text.replace(QChar::Nbsp, QChar(' '));
+
+        for (auto& view : localViewDocuments_) {
+            // Behind until its queue is flushed (or it's resynced)
+            if (!view.pending.isEmpty() || view.resyncCursorPos > -1) continue;
 
-        for (auto& view_doc : localViewDocuments_) {
+            auto view_doc = view.document;
             auto view_text = view_doc->toPlainText();
 
             if (view_text != prime_text) {
@@ -409,54 +720,107 @@ private:
 private slots:
     // TODO: Clean this
     // TODO: Rename (titleChange_ or similar)?
-    void onDocumentContentsChange_(
-        [[maybe_unused]] int from,
-        [[maybe_unused]] int charsRemoved,
-        [[maybe_unused]] int charsAdded)
+    void onPrimeContentsChanged_()
     {
         auto meta = this->meta();
         if (!meta || meta->isOnDisk()) return;
 
         // TODO: Could move the below (or portions) to Coco
 
-        // Iterate through text blocks to find the first non-empty one
-        for (auto block = primeDocument_->begin(); block.isValid();
-             block = block.next()) {
-            // Get trimmed text from the block
-            if (auto block_text = block.text().trimmed();
-                !block_text.isEmpty()) {
-
-                // Prevent titles with markup for markups
-                if (meta->fileType() == Files::Markdown
-                    && block_text.startsWith('#')) {
-                    auto space_idx = block_text.indexOf(QChar(' '));
-                    if (space_idx == -1) continue;
-                    block_text = block_text.mid(space_idx + 1).trimmed();
-                    if (block_text.isEmpty()) continue;
-                } else if (
-                    meta->fileType() == Files::Fountain
-                    && block_text.startsWith(
-                        u"Title:"_s,
-                        Qt::CaseInsensitive)) {
-                    block_text = block_text.mid(6).trimmed();
-                    if (block_text.isEmpty()) continue;
-                }
-
-                // Limit title to first 27 (30 total if using ellipses)
-                // characters
-                auto title = block_text.left(27);
-
-                // TODO: I'd prefer just "rounding" to nearest word for the save
-                // file name for unsaved file
-                if (block_text.length() > 27) title += u"..."_s;
-
-                meta->setTitleOverride(title);
-                return;
+        QString title{};
+
+        // Iterate through lines to find the first non-empty one
+        prime_->forEachLine([&](const QString& line) {
+            // Get trimmed text from the line
+            auto line_text = line.trimmed();
+            if (line_text.isEmpty()) return true;
+
+            // Prevent titles with markup for markups
+            if (meta->fileType() == Files::Markdown
+                && line_text.startsWith('#')) {
+                auto space_idx = line_text.indexOf(QChar(' '));
+                if (space_idx == -1) return true;
+                line_text = line_text.mid(space_idx + 1).trimmed();
+                if (line_text.isEmpty()) return true;
+            } else if (
+                meta->fileType() == Files::Fountain
+                && line_text.startsWith(u"Title:"_s, Qt::CaseInsensitive)) {
+                line_text = line_text.mid(6).trimmed();
+                if (line_text.isEmpty()) return true;
             }
-        }
 
-        meta->clearTitleOverride();
+            // Limit title to first 27 (30 total if using ellipses)
+            // characters
+            title = line_text.left(27);
+
+            // TODO: I'd prefer just "rounding" to nearest word for the save
+            // file name for unsaved file
+            if (line_text.length() > 27) title += u"..."_s;
+
+            return false;
+        });
+
+        if (title.isEmpty())
+            meta->clearTitleOverride();
+        else
+            meta->setTitleOverride(title);
     }
 };
 
 } // namespace Hearth
+
+// Tests:
+
+/*#include <QElapsedTimer>
+
+// Per-keystroke routing cost with 1, 4, and 8 split views. Types into the
+// first view doc, as a TextFileView would, and times the whole round trip
+// (extract once, apply to prime and every other view). Deltas are flushed
+// after every keystroke, as the next tick would between key presses, so the
+// cost of applying them to the other views is counted rather than batched
+// away. Call from anywhere with a QApplication
+namespace TextFileModelBenchmark {
+
+inline qint64 typingNs(int views, int keystrokes, qsizetype baseChars)
+{
+    using namespace Hearth;
+
+    TextFileModel model(Files::PlainText);
+    model.setData(QByteArray(baseChars, 'x'));
+
+    QList<QTextDocument*> docs{};
+    for (auto i = 0; i < views; ++i) {
+        auto doc = new QTextDocument(&model);
+        doc->setDocumentLayout(new QPlainTextDocumentLayout(doc));
+        model.registerViewDocument(doc);
+        docs << doc;
+    }
+
+    QTextCursor cursor(docs[0]);
+    cursor.setPosition(int(baseChars / 2));
+    QElapsedTimer timer{};
+
+    timer.start();
+    for (auto i = 0; i < keystrokes; ++i) {
+        cursor.insertText((i % 60 == 59) ? u"\n"_s : u"a"_s);
+        model.flushPendingDeltas();
+    }
+
+    return timer.nsecsElapsed() / keystrokes;
+}
+
+inline void run(int keystrokes = 5000, qsizetype baseChars = 1'000'000)
+{
+    DEBUG(
+        "=== Delta Routing ({} chars, {} keystrokes) ===",
+        baseChars,
+        keystrokes);
+
+    for (auto views : { 1, 4, 8 })
+        DEBUG(
+            "{} view(s): {} ns/keystroke",
+            views,
+            typingNs(views, keystrokes, baseChars));
+}
+
+} // namespace TextFileModelBenchmark*/
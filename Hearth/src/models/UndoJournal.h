@@ -0,0 +1,159 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QIODevice>
+#include <QList>
+#include <QString>
+#include <QTemporaryFile>
+
+#include <Coco/Path.h>
+
+#include "core/AppDirs.h"
+#include "core/Debug.h"
+
+namespace Hearth {
+
+using namespace Qt::StringLiterals;
+
+// A stack of undo steps spilled to disk (see PieceTable::setUndoBudget). Steps
+// are stored as plain text edits, each step one compressed record appended to
+// a temporary file under AppDirs::tempUndo(). Popping reads the last record
+// and truncates the file, so steps come back most recent first, which is the
+// order undo needs them.
+//
+// The file is created on first push and removed with the journal. A crash
+// leaves it behind, so journals left from an earlier run are removed at
+// startup (see removeStale)
+class UndoJournal
+{
+public:
+    // Hearth runs as a single instance (see StartCop), so at startup no
+    // journal in AppDirs::tempUndo() can belong to a live process. Call
+    // before any journal is created
+    static void removeStale()
+    {
+        auto paths =
+            Coco::filePaths(AppDirs::tempUndo(), { u"*.journal"_s });
+
+        for (auto& path : paths)
+            if (!Coco::remove(path))
+                WARN("Failed to remove stale undo journal {}!", path);
+    }
+
+    struct Edit
+    {
+        qsizetype pos = 0;
+        QString removed{};
+        QString inserted{};
+    };
+
+    using Step = QList<Edit>;
+
+    qsizetype size() const noexcept { return offsets_.size(); }
+    bool isEmpty() const noexcept { return offsets_.isEmpty(); }
+
+    void clear()
+    {
+        offsets_.clear();
+        file_.reset();
+    }
+
+    bool push(const Step& step)
+    {
+        if (!ensureFile_()) return false;
+
+        QByteArray bytes{};
+        QDataStream out(&bytes, QIODevice::WriteOnly);
+        out << qint64(step.size());
+        for (auto& edit : step)
+            out << qint64(edit.pos) << edit.removed << edit.inserted;
+
+        auto record = qCompress(bytes);
+        auto offset = file_->size();
+
+        if (!file_->seek(offset) || file_->write(record) != record.size()) {
+            WARN("Failed to write undo journal at {}!", file_->fileName());
+            file_->resize(offset);
+            return false;
+        }
+
+        offsets_ << offset;
+        return true;
+    }
+
+    // Returns false (and leaves step untouched) if empty or unreadable
+    bool pop(Step& step)
+    {
+        if (offsets_.isEmpty() || !file_) return false;
+
+        auto offset = offsets_.takeLast();
+        file_->seek(offset);
+        auto bytes = qUncompress(file_->readAll());
+        file_->resize(offset);
+
+        if (bytes.isEmpty()) {
+            WARN("Failed to read undo journal at {}!", file_->fileName());
+            return false;
+        }
+
+        QDataStream in(bytes);
+        qint64 count = 0;
+        in >> count;
+
+        Step read{};
+        read.reserve(count);
+
+        for (qint64 i = 0; i < count; ++i) {
+            qint64 pos = 0;
+            Edit edit{};
+            in >> pos >> edit.removed >> edit.inserted;
+            edit.pos = pos;
+            read << edit;
+        }
+
+        if (in.status() != QDataStream::Ok) return false;
+
+        step = read;
+        return true;
+    }
+
+private:
+    std::unique_ptr<QTemporaryFile> file_{};
+    QList<qint64> offsets_{};
+
+    bool ensureFile_()
+    {
+        if (file_) return true;
+
+        auto file = std::make_unique<QTemporaryFile>(
+            (AppDirs::tempUndo() / "XXXXXX.journal").toQString());
+
+        if (!file->open()) {
+            WARN(
+                "Failed to open undo journal in {} (Error: {})!",
+                AppDirs::tempUndo(),
+                file->errorString());
+            return false;
+        }
+
+        file_ = std::move(file);
+        return true;
+    }
+};
+
+} // namespace Hearth
@@ -59,6 +59,24 @@ public:
         }
     }
 
+    void progress(int percent, Window* window = nullptr) const
+    {
+        if (colorBars_.isEmpty()) return;
+
+        if (window) {
+            if (!window->isVisible()) return;
+            if (auto color_bar = colorBars_[window])
+                color_bar->setProgress(ColorBar::Green, percent);
+        } else {
+            for (auto it = colorBars_.begin(); it != colorBars_.end(); ++it) {
+                auto window = it.key();
+                if (!window || !window->isVisible()) continue;
+                if (auto color_bar = it.value())
+                    color_bar->setProgress(ColorBar::Green, percent);
+            }
+        }
+    }
+
 protected:
     // TODO: Could have commands to run all color bars and call that in save
     // functions instead of having slightly convoluted, overly-specific save
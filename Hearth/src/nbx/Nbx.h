@@ -17,10 +17,14 @@
 
 #include <QByteArray>
 #include <QDir>
-#include <QDomDocument>
-#include <QDomElement>
+#include <QFileInfo>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QSaveFile>
+#include <QSet>
 #include <QString>
-#include <QUuid>
+#include <QStringList>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 
@@ -28,16 +32,13 @@
 
 #include <Coco/Path.h>
 
-#include "core/Files.h"
 #include "core/Io.h"
+#include "nbx/NbxDeflate.h"
 
 // .hearthx file format specification and utilities
 // - Nbx::Io: Archive and working directory operations
-// - Nbx::Xml: DOM element factories and queries (stateless helpers)
-//
-// TODO: Are all these element.isNull checks necessary? Not sure...
-// TODO: For mutators, probably pass QDomElement by value (otherwise by const
-// ref). There are issues with passing QDomElement& for mutators
+// - Nbx::Xml: Manifest and content file I/O (the structure itself lives in
+//   NbxTree)
 namespace Hearth::Nbx {
 
 namespace Internal {
@@ -50,6 +51,10 @@ namespace Internal {
     constexpr auto IO_MANIFEST_FILE_NAME_ = "Manifest.xml";
     constexpr auto IO_CONTENT_DIR_NAME_ = "content";
 
+    // Entries extract to a file with this suffix beside their final path,
+    // renamed into place only once complete
+    constexpr auto IO_EXTRACT_TEMP_SUFFIX_ = ".extracting";
+
     // Xml
 
     constexpr auto XML_INDENT_ = 2;
@@ -67,237 +72,190 @@ namespace Internal {
         "parent_on_restore_uuid";
     constexpr auto XML_FILE_EXT_ATTR_ = "extension";
     constexpr auto XML_FILE_EDITED_ATTR_ = "edited";
-    constexpr auto XML_NULL_DOM_ = "DOM is null!";
 
-    inline QString makeUuid_()
+    // Maps each entry name in an open archive to its index, so lookups during
+    // an incremental save don't rescan the central directory
+    inline QHash<QString, int> entryIndices_(mz_zip_archive* zip)
     {
-        return QUuid::createUuid().toString(QUuid::WithoutBraces);
-    }
-
-} // namespace Internal
-
-// Used by NbxModel
-namespace Xml {
+        QHash<QString, int> indices{};
+        auto file_count = mz_zip_reader_get_num_files(zip);
+        indices.reserve(file_count);
 
-    constexpr auto DOCUMENT_ELEMENT_TAG = "nbx";
-    constexpr auto NOTEBOOK_TAG = "notebook";
-    constexpr auto TRASH_TAG = "trash";
+        for (mz_uint i = 0; i < file_count; ++i) {
+            mz_zip_archive_file_stat stat{};
+            if (!mz_zip_reader_file_stat(zip, i, &stat)) continue;
+            if (stat.m_is_directory) continue;
+            indices.insert(QString::fromUtf8(stat.m_filename), i);
+        }
 
-    inline bool isVirtualFolder(const QDomElement& element)
-    {
-        if (element.isNull()) return false;
-        return element.tagName() == Internal::XML_VFOLDER_TAG_;
+        return indices;
     }
 
-    inline bool isFile(const QDomElement& element)
+    // How close (in seconds) an entry's stored mtime may be to its archive's
+    // write time before a matching mtime stops proving anything. Covers the
+    // second the entry was read in plus the 2-second rounding of zip times
+    constexpr qint64 RACY_SECS_ = 2;
+
+    // Returns the base archive index of an entry whose stored bytes are still
+    // valid for the file at path, or -1 if the file needs deflating. Extraction
+    // stamps files with their archived mtime, so matching size and mtime means
+    // untouched. A mismatched mtime with a matching size (e.g., a save that
+    // rewrote identical bytes) falls back to comparing CRCs
+    //
+    // So does a "racy" entry, whose stored mtime is within RACY_SECS_ of
+    // baseWriteSecs (the base archive's write time): the file may have been
+    // saved again within the same second it was archived, with the same
+    // length, and so kept an mtime that still matches
+    inline int reusableEntryIndex_(
+        mz_zip_archive* baseZip,
+        qint64 baseWriteSecs,
+        const QHash<QString, int>& baseEntries,
+        const QString& entryName,
+        const Coco::Path& path)
     {
-        if (element.isNull()) return false;
-        return element.tagName() == Internal::XML_FILE_TAG_;
-    }
+        auto index = baseEntries.value(entryName, -1);
+        if (index < 0) return -1;
 
-    inline bool isEdited(const QDomElement& element)
-    {
-        return element.hasAttribute(Internal::XML_FILE_EDITED_ATTR_);
-    }
+        mz_zip_archive_file_stat stat{};
+        if (!mz_zip_reader_file_stat(baseZip, index, &stat)) return -1;
 
-    inline bool hasEditedDescendant(const QDomElement& element)
-    {
-        auto child = element.firstChildElement();
+        QFileInfo info(path.toQString());
+        if (stat.m_uncomp_size != static_cast<mz_uint64>(info.size()))
+            return -1;
 
-        while (!child.isNull()) {
-            if (isFile(child) && isEdited(child)) return true;
-            if (hasEditedDescendant(child)) return true;
-            child = child.nextSiblingElement();
-        }
+        auto racy = baseWriteSecs - qint64(stat.m_time) <= RACY_SECS_;
+        if (!racy && stat.m_time == info.lastModified().toSecsSinceEpoch())
+            return index;
 
-        return false;
-    }
+        auto data = Hearth::Io::read(path);
+        auto crc = mz_crc32(
+            MZ_CRC32_INIT,
+            reinterpret_cast<const unsigned char*>(data.constData()),
+            static_cast<size_t>(data.size()));
 
-    inline QString name(const QDomElement& element)
-    {
-        return element.attribute(Internal::XML_NAME_ATTR_);
+        return crc == stat.m_crc32 ? index : -1;
     }
 
-    inline QString uuid(const QDomElement& element)
+    // Extracts one entry beneath workingDir, keeping its relative path.
+    // Extraction stamps the file with the entry's archived mtime. The file
+    // only appears at its path once fully written, so an interrupted or
+    // failed extraction never leaves a truncated file that looks extracted
+    inline bool extractEntry_(
+        mz_zip_archive* zip,
+        mz_uint index,
+        const Coco::Path& workingDir)
     {
-        return element.attribute(Internal::XML_UUID_ATTR_);
-    }
+        mz_zip_archive_file_stat stat{};
 
-    inline QString ext(const QDomElement& element)
-    {
-        return element.attribute(Internal::XML_FILE_EXT_ATTR_);
-    }
+        if (!mz_zip_reader_file_stat(zip, index, &stat)) {
+            WARN("Failed to stat archive entry {}", index);
+            return false;
+        }
 
-    inline Coco::Path relPath(const QDomElement& element)
-    {
-        if (!isFile(element)) return {};
-        auto file_name = uuid(element) + ext(element);
-        return Coco::Path(Internal::IO_CONTENT_DIR_NAME_) / file_name;
-    }
+        auto out_path = workingDir / stat.m_filename;
 
-    inline void rename(QDomElement element, const QString& name)
-    {
-        if (element.isNull() || !element.hasAttribute(Internal::XML_NAME_ATTR_)
-            || name.isEmpty())
-            return;
-        element.setAttribute(Internal::XML_NAME_ATTR_, name);
-    }
+        if (stat.m_is_directory) return Coco::mkpath(out_path);
 
-    // Setting false removes the attribute (the attribute is itself the boolean)
-    inline void setEdited(QDomElement element, bool edited)
-    {
-        if (element.isNull() || !isFile(element)) return;
-        edited ? element.setAttribute(Internal::XML_FILE_EDITED_ATTR_, "")
-               : element.removeAttribute(Internal::XML_FILE_EDITED_ATTR_);
-    }
+        Coco::mkpath(out_path.parent());
+        auto temp_path = out_path.toString() + IO_EXTRACT_TEMP_SUFFIX_;
 
-    inline QString restoreParentUuid(const QDomElement& element)
-    {
-        return element.attribute(Internal::XML_TRASH_RESTORE_PARENT_UUID_ATTR_);
-    }
+        if (!mz_zip_reader_extract_to_file(zip, index, temp_path.c_str(), 0)) {
+            WARN(
+                "Failed to extract {}: {}",
+                stat.m_filename,
+                mz_zip_get_error_string(mz_zip_get_last_error(zip)));
+            Coco::remove(temp_path);
+            return false;
+        }
 
-    inline void setRestoreParentUuid(QDomElement& element, const QString& uuid)
-    {
-        uuid.isEmpty() ? element.removeAttribute(
-                             Internal::XML_TRASH_RESTORE_PARENT_UUID_ATTR_)
-                       : element.setAttribute(
-                             Internal::XML_TRASH_RESTORE_PARENT_UUID_ATTR_,
-                             uuid);
-    }
+        if (out_path.exists()) Coco::remove(out_path);
 
-    inline void clearRestoreParentUuid(QDomElement& element)
-    {
-        setRestoreParentUuid(element, {});
-    }
+        if (!Coco::rename(temp_path, out_path)) {
+            WARN("Failed to move extracted {} into place", stat.m_filename);
+            Coco::remove(temp_path);
+            return false;
+        }
 
-    inline QDomElement notebookElement(const QDomDocument& dom)
-    {
-        return dom.documentElement().firstChildElement(Xml::NOTEBOOK_TAG);
+        return true;
     }
 
-    inline QDomElement trashElement(const QDomDocument& dom)
-    {
-        return dom.documentElement().firstChildElement(Xml::TRASH_TAG);
-    }
+} // namespace Internal
 
-    inline bool isInTrash(const QDomDocument& dom, const QDomElement& element)
-    {
-        auto trash = trashElement(dom);
-        auto current = element.parentNode().toElement();
-        while (!current.isNull()) {
-            if (current == trash) return true;
-            current = current.parentNode().toElement();
-        }
+// Used by NbxModel (see NbxTree)
+namespace Xml {
 
-        return false;
-    }
+    constexpr auto DOCUMENT_ELEMENT_TAG = "nbx";
+    constexpr auto NOTEBOOK_TAG = "notebook";
+    constexpr auto TRASH_TAG = "trash";
 
-    inline QDomDocument makeDom(const Coco::Path& workingDir)
+    inline QByteArray readManifest(const Coco::Path& workingDir)
     {
         if (!workingDir.exists()) {
             CRITICAL(Internal::WORKING_DIR_MISSING_FMT_, workingDir);
             return {};
         }
 
-        QDomDocument doc{};
-        auto content =
-            Hearth::Io::read(workingDir / Internal::IO_MANIFEST_FILE_NAME_);
-        auto result = doc.setContent(content);
-
-        if (!result) {
-            CRITICAL(
-                "Failed to parse {}! Error: {} at line {}, column {}.",
-                Internal::IO_MANIFEST_FILE_NAME_,
-                result.errorMessage,
-                result.errorLine,
-                result.errorColumn);
-            return {};
-        }
-
-        return doc;
+        return Hearth::Io::read(workingDir / Internal::IO_MANIFEST_FILE_NAME_);
     }
 
-    // TODO: Return bool?
-    inline void
-    writeManifest(const Coco::Path& workingDir, const QDomDocument& dom)
+    // Writes the nodes of a manifest (see NbxTree::write)
+    using ManifestWriter = std::function<void(QXmlStreamWriter&)>;
+
+    // Streams the manifest straight into a QSaveFile, so the serialized XML
+    // is never held in memory as a whole. A failed write leaves the previous
+    // manifest in place
+    inline bool
+    writeManifest(const Coco::Path& workingDir, const ManifestWriter& writer)
     {
         if (!workingDir.exists()) {
             CRITICAL(Internal::WORKING_DIR_MISSING_FMT_, workingDir);
-            return;
+            return false;
         }
 
-        if (dom.isNull()) {
-            CRITICAL(Internal::XML_NULL_DOM_);
-            return;
+        auto path = workingDir / Internal::IO_MANIFEST_FILE_NAME_;
+        QSaveFile file(path.toQString());
+
+        if (!file.open(QIODevice::WriteOnly)) {
+            CRITICAL(
+                "Failed to open manifest {} for writing (Error: {})!",
+                path,
+                file.errorString());
+            return false;
         }
 
-        auto xml = dom.toByteArray(Internal::XML_INDENT_);
-        auto path = workingDir / Internal::IO_MANIFEST_FILE_NAME_;
+        QXmlStreamWriter xml(&file);
+        writer(xml);
 
-        if (!Hearth::Io::write(xml, path))
+        if (xml.hasError() || !file.commit()) {
+            file.cancelWriting();
             CRITICAL("Failed to write manifest to {}!", path);
+            return false;
+        }
+
+        return true;
     }
 
-    inline QDomElement addNewFile(
-        Files::Type fileType,
-        const QString& extension,
+    // Creates the (empty) content file for a new file element. Returns false
+    // if it couldn't be created
+    inline bool makeContentFile(
         const Coco::Path& workingDir,
-        QDomDocument& dom)
+        const QString& uuid,
+        const QString& extension)
     {
         if (!workingDir.exists()) {
             CRITICAL(Internal::WORKING_DIR_MISSING_FMT_, workingDir);
-            return {};
-        }
-
-        if (dom.isNull()) {
-            CRITICAL(Internal::XML_NULL_DOM_);
-            return {};
+            return false;
         }
 
-        auto uuid = Internal::makeUuid_();
-        auto ext =
-            extension.isEmpty() ? Files::canonicalExt(fileType) : extension;
-        auto file_name = uuid + ext;
-        auto path = workingDir / Internal::IO_CONTENT_DIR_NAME_ / file_name;
+        auto path =
+            workingDir / Internal::IO_CONTENT_DIR_NAME_ / (uuid + extension);
 
         if (!Hearth::Io::write({}, path)) {
             WARN("Failed to create text file at {}", path);
-            return {};
-        }
-
-        auto element = dom.createElement(Internal::XML_FILE_TAG_);
-        element.setAttribute(
-            Internal::XML_NAME_ATTR_,
-            Internal::XML_NAME_ATTR_FILE_DEF_);
-        element.setAttribute(Internal::XML_UUID_ATTR_, uuid);
-        element.setAttribute(Internal::XML_FILE_EXT_ATTR_, ext);
-
-        return element;
-    }
-
-    inline QDomElement addNewFile(
-        Files::Type fileType,
-        const Coco::Path& workingDir,
-        QDomDocument& dom)
-    {
-        return addNewFile(fileType, {}, workingDir, dom);
-    }
-
-    inline QDomElement addVirtualFolder(QDomDocument& dom)
-    {
-        if (dom.isNull()) {
-            CRITICAL(Internal::XML_NULL_DOM_);
-            return {};
+            return false;
         }
 
-        auto element = dom.createElement(Internal::XML_VFOLDER_TAG_);
-
-        element.setAttribute(
-            Internal::XML_NAME_ATTR_,
-            Internal::XML_NAME_ATTR_DIR_DEF_);
-        element.setAttribute(Internal::XML_UUID_ATTR_, Internal::makeUuid_());
-
-        return element;
+        return true;
     }
 
 } // namespace Xml
@@ -309,6 +267,36 @@ namespace Io {
     using BeforeOverwriteHook =
         std::function<void(const Coco::Path& originalNbx)>;
 
+    // Called after each entry is added. May be called from a worker thread
+    using ProgressHook = std::function<void(qsizetype done, qsizetype total)>;
+
+    struct CompressOptions
+    {
+        // Existing archive to copy unchanged entries from (normally the one
+        // being saved over)
+        Coco::Path baseArchivePath{};
+
+        // Files to archive. When empty, everything in the working directory
+        // is archived
+        Coco::PathList entries{};
+
+        // Entries copied as-is from the base archive, without a working copy
+        // (e.g., content that hasn't been extracted yet)
+        QStringList baseOnlyEntries{};
+
+        // When not empty, archived in place of the working directory's
+        // Manifest.xml. Lets a caller snapshot the manifest on the GUI thread
+        // and compress on another while the working copy keeps changing
+        QByteArray manifest{};
+
+        // Deflate level for text (and anything else not already compressed;
+        // see Deflate::levelFor). Doesn't affect entries reused unchanged
+        int textLevel = MZ_DEFAULT_LEVEL;
+
+        BeforeOverwriteHook beforeOverwriteHook{};
+        ProgressHook progressHook{};
+    };
+
     inline void makeNewWorkingDir(const Coco::Path& workingDir)
     {
         // Create content directory
@@ -339,9 +327,21 @@ namespace Io {
             workingDir / Internal::IO_MANIFEST_FILE_NAME_);
     }
 
+    // Content entries (everything under content/) aren't needed to open a
+    // Notebook and can be extracted later, on demand
+    inline bool isContentEntry(const QString& entryName)
+    {
+        return entryName.startsWith(
+            QString(Internal::IO_CONTENT_DIR_NAME_) + "/");
+    }
+
+    // Extracts the entries accepted by filter (or all of them, if there is no
+    // filter)
     // TODO: Return bool? Fully fail if any file fails?
-    inline void
-    extract(const Coco::Path& archivePath, const Coco::Path& workingDir)
+    inline void extract(
+        const Coco::Path& archivePath,
+        const Coco::Path& workingDir,
+        const std::function<bool(const QString& entryName)>& filter = {})
     {
         INFO("Extracting archive at {} to {}", archivePath, workingDir);
 
@@ -370,42 +370,39 @@ namespace Io {
         auto file_count = mz_zip_reader_get_num_files(&zip);
 
         for (mz_uint i = 0; i < file_count; ++i) {
-
-            // Get metadata
-            mz_zip_archive_file_stat stat{};
-
-            if (!mz_zip_reader_file_stat(&zip, i, &stat)) {
-                WARN("Failed to stat archive entry {}", i);
-                continue;
-            }
-
-            // Write
-            auto out_path = workingDir / stat.m_filename;
-
-            if (mz_zip_reader_is_file_a_directory(&zip, i)) {
-                Coco::mkpath(out_path);
-                continue;
+            if (filter) {
+                mz_zip_archive_file_stat stat{};
+                if (!mz_zip_reader_file_stat(&zip, i, &stat)) continue;
+                if (!filter(QString::fromUtf8(stat.m_filename))) continue;
             }
 
-            Coco::mkpath(out_path.parent());
-
-            if (!mz_zip_reader_extract_to_file(
-                    &zip,
-                    i,
-                    out_path.toString().c_str(),
-                    0)) {
-                WARN(
-                    "Failed to extract {}: {}",
-                    stat.m_filename,
-                    mz_zip_get_error_string(mz_zip_get_last_error(&zip)));
-            }
+            Internal::extractEntry_(&zip, i, workingDir);
         }
     }
 
+    // Extracts only what's needed to open the Notebook (Manifest.xml,
+    // Settings.ini). See NotebookExtractor for the rest
+    inline void
+    extractSkeleton(const Coco::Path& archivePath, const Coco::Path& workingDir)
+    {
+        extract(archivePath, workingDir, [](const QString& entryName) {
+            return !isContentEntry(entryName);
+        });
+    }
+
+    // Builds a new archive from the working directory. When baseArchivePath
+    // names an existing archive (normally the one being saved over), entries
+    // whose files haven't changed since that archive was written are copied
+    // over as raw compressed bytes instead of being deflated again, so save
+    // time scales with the edit rather than the size of the Notebook. Entries
+    // that do need deflating are compressed in parallel (see NbxDeflate.h)
+    //
+    // Safe to call off the GUI thread, provided nothing removes working
+    // directory files while it runs
     inline bool compress(
         const Coco::Path& archivePath,
         const Coco::Path& workingDir,
-        const BeforeOverwriteHook& beforeOverwriteHook = {})
+        const CompressOptions& options = {})
     {
         INFO("Compressing archive at {} to {}", workingDir, archivePath);
 
@@ -427,30 +424,206 @@ namespace Io {
 
         auto cleanup = qScopeGuard([&] { mz_zip_writer_end(&zip); });
 
+        // Open the previous archive for raw entry reuse. Failure here isn't
+        // fatal; it just means a full save
+        mz_zip_archive base_zip{};
+        const auto& base_path = options.baseArchivePath;
+        auto has_base = !base_path.isEmpty() && base_path.exists()
+                        && mz_zip_reader_init_file(
+                            &base_zip,
+                            base_path.toString().c_str(),
+                            0);
+        auto base_cleanup = qScopeGuard([&] {
+            if (has_base) mz_zip_reader_end(&base_zip);
+        });
+
+        auto base_entries = has_base ? Internal::entryIndices_(&base_zip)
+                                     : QHash<QString, int>{};
+        auto base_write_secs =
+            has_base ? QFileInfo(base_path.toQString())
+                           .lastModified()
+                           .toSecsSinceEpoch()
+                     : qint64(0);
+
         auto ok = true; // Get warnings for all fails
-        auto entries = Coco::allFilePaths(workingDir);
+        auto reused = 0;
+        auto entries = options.entries.isEmpty()
+                           ? Coco::allFilePaths(workingDir)
+                           : options.entries;
+        auto override_manifest = !options.manifest.isEmpty();
+
+        qsizetype done = 0;
+        qsizetype total = entries.size() + options.baseOnlyEntries.size();
+        auto report = [&] {
+            if (options.progressHook) options.progressHook(++done, total);
+        };
+
+        if (override_manifest) {
+            if (!mz_zip_writer_add_mem(
+                    &zip,
+                    Internal::IO_MANIFEST_FILE_NAME_,
+                    options.manifest.constData(),
+                    static_cast<size_t>(options.manifest.size()),
+                    static_cast<mz_uint>(options.textLevel))) {
+                WARN(
+                    "Failed to add {}: {}",
+                    Internal::IO_MANIFEST_FILE_NAME_,
+                    mz_zip_get_error_string(mz_zip_get_last_error(&zip)));
+                ok = false;
+            }
+
+            ++total;
+            report();
+        }
+
+        // Entries are appended in order, a window at a time. Changed files in
+        // the window are deflated in parallel first; reused entries are copied
+        // raw from the base archive by this thread when their turn comes
+        struct Planned
+        {
+            std::string rel{};
+            Coco::Path path{};
+            int baseIndex = -1;
+        };
+
+        QList<Planned> window{};
+        qint64 window_bytes = 0;
+
+        auto flush_window = [&] {
+            QList<Deflate::Job> jobs{};
+
+            for (const auto& planned : window)
+                if (planned.baseIndex < 0)
+                    jobs << Deflate::Job{ planned.rel,
+                                          planned.path,
+                                          options.textLevel };
+
+            auto buffers = Deflate::deflateAll(jobs);
+            auto next_buffer = 0;
+
+            for (const auto& planned : window) {
+                if (planned.baseIndex >= 0) {
+                    if (mz_zip_writer_add_from_zip_reader(
+                            &zip,
+                            &base_zip,
+                            static_cast<mz_uint>(planned.baseIndex))) {
+                        ++reused;
+                        report();
+                        continue;
+                    }
+
+                    // Fall back to deflating from disk on this thread
+                    WARN(
+                        "Failed to reuse {} from base archive: {}",
+                        planned.rel,
+                        mz_zip_get_error_string(mz_zip_get_last_error(&zip)));
+
+                    auto buffer = Deflate::deflate(
+                        { planned.rel, planned.path, options.textLevel });
+
+                    if (!Deflate::append(&zip, buffer)) {
+                        WARN("Failed to add {}", planned.rel);
+                        ok = false;
+                    }
+
+                    report();
+                    continue;
+                }
+
+                if (!Deflate::append(&zip, buffers[next_buffer++])) {
+                    WARN(
+                        "Failed to add {}: {}",
+                        planned.rel,
+                        mz_zip_get_error_string(mz_zip_get_last_error(&zip)));
+                    ok = false;
+                }
+
+                report();
+            }
+
+            window.clear();
+            window_bytes = 0;
+        };
+
+        // Names written from the working directory, so base-only entries
+        // that also have a working copy aren't written twice
+        QSet<QString> written{};
 
         for (const auto& entry_path : entries) {
             // Make relative path (zip expects generic path)
             auto rel = entry_path.lexicallyRelative(workingDir).genericString();
 
-            if (!mz_zip_writer_add_file(
+            // Left by an extraction a crash interrupted
+            if (QString::fromStdString(rel).endsWith(
+                    QLatin1StringView(Internal::IO_EXTRACT_TEMP_SUFFIX_))) {
+                --total;
+                continue;
+            }
+
+            written << QString::fromStdString(rel);
+
+            if (override_manifest && rel == Internal::IO_MANIFEST_FILE_NAME_) {
+                --total;
+                continue;
+            }
+
+            // The manifest changes with nearly every save, so it's always
+            // written fresh
+            auto base_index = -1;
+            if (has_base && rel != Internal::IO_MANIFEST_FILE_NAME_) {
+                base_index = Internal::reusableEntryIndex_(
+                    &base_zip,
+                    base_write_secs,
+                    base_entries,
+                    QString::fromStdString(rel),
+                    entry_path);
+            }
+
+            if (base_index < 0) {
+                auto size = QFileInfo(entry_path.toQString()).size();
+
+                if (!window.isEmpty()
+                    && window_bytes + size > Deflate::WINDOW_BYTES)
+                    flush_window();
+
+                window_bytes += size;
+            }
+
+            window << Planned{ rel, entry_path, base_index };
+        }
+
+        flush_window();
+
+        for (const auto& entry_name : options.baseOnlyEntries) {
+            if (written.contains(entry_name)) {
+                --total;
+                continue;
+            }
+
+            auto base_index = base_entries.value(entry_name, -1);
+
+            if (base_index < 0
+                || !mz_zip_writer_add_from_zip_reader(
                     &zip,
-                    rel.c_str(),
-                    entry_path.toString().c_str(),
-                    nullptr,
-                    0,
-                    MZ_DEFAULT_COMPRESSION)) {
-                WARN(
-                    "Failed to add {}: {}",
-                    rel,
-                    mz_zip_get_error_string(mz_zip_get_last_error(&zip)));
+                    &base_zip,
+                    static_cast<mz_uint>(base_index))) {
+                WARN("Failed to carry over {} from base archive", entry_name);
                 ok = false;
+                continue;
             }
+
+            ++reused;
+            report();
         }
 
+        INFO("Reused {} of {} archive entries unchanged", reused, total);
+
         if (ok) ok = mz_zip_writer_finalize_archive(&zip);
 
+        // Close the base reader before anything touches the original archive
+        base_cleanup.dismiss();
+        if (has_base) mz_zip_reader_end(&base_zip);
+
         if (!ok) {
             CRITICAL("NBX archive compression failed!");
             Coco::remove(temp_path);
@@ -462,7 +635,8 @@ namespace Io {
         mz_zip_writer_end(&zip);
 
         /// TODO BA
-        if (beforeOverwriteHook) beforeOverwriteHook(archivePath);
+        if (options.beforeOverwriteHook)
+            options.beforeOverwriteHook(archivePath);
         Coco::remove(archivePath);
 
         return Coco::rename(temp_path, archivePath);
@@ -0,0 +1,220 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <string>
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QList>
+#include <QtConcurrent>
+
+#include <miniz.h>
+
+#include <Coco/Path.h>
+
+#include "core/Debug.h"
+#include "core/Files.h"
+#include "core/MagicBytes.h"
+
+// Multi-core deflate for Nbx::Io::compress. Entries are read and deflated on
+// the global thread pool into in-memory buffers, then appended to the archive
+// in their original order by the single thread that owns the zip writer
+// (miniz writers aren't thread-safe)
+namespace Hearth::Nbx::Deflate {
+
+// Inputs are processed in windows so that peak memory stays bounded no matter
+// how large the Notebook is. A single file larger than this gets a window to
+// itself
+constexpr qint64 WINDOW_BYTES = 64 * 1024 * 1024;
+
+// Formats that are compressed already. Deflating them costs time and saves
+// next to nothing, so they're stored as-is (level 0)
+inline bool isPrecompressed(Files::Type type)
+{
+    switch (type) {
+    case Files::Pdf:
+    case Files::Png:
+    case Files::Jpeg:
+    case Files::Gif:
+    case Files::WebP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Compression level for a file. Everything that isn't precompressed (text,
+// mostly) gets textLevel
+inline int levelFor(const Coco::Path& path, int textLevel)
+{
+    auto type = Files::fromPath(path);
+    if (isPrecompressed(type)) return 0;
+
+    // Unrecognized extensions also resolve to PlainText, so check the
+    // signature of anything not actually named as text
+    if (type == Files::PlainText
+        && path.extQString().toLower() != Files::canonicalExt(type)) {
+        auto magic = MagicBytes::type(path);
+        if (magic == MagicBytes::Zip) return 0;
+        if (magic != MagicBytes::NoKnownSignature
+            && isPrecompressed(Files::fromMagicBytes(magic)))
+            return 0;
+    }
+
+    return textLevel;
+}
+
+struct Job
+{
+    std::string name{}; // Archive entry name (generic, relative)
+    Coco::Path path{};
+    int textLevel = MZ_DEFAULT_LEVEL; // See levelFor
+};
+
+// A raw deflate stream (or stored bytes, if level is 0) plus everything the
+// zip writer would otherwise compute itself
+struct Buffer
+{
+    std::string name{};
+    QByteArray data{};
+    mz_uint64 uncompressedSize = 0;
+    mz_uint32 crc32 = 0;
+    MZ_TIME_T modified = 0;
+    int level = 0;
+    bool ok = false;
+};
+
+// Reads and deflates a single file. Safe to call from any thread
+inline Buffer deflate(const Job& job)
+{
+    Buffer buffer{};
+    buffer.name = job.name;
+    buffer.level = levelFor(job.path, job.textLevel);
+
+    // Stat before reading. If the file is written again while we read it, the
+    // archive records the older mtime, and the next incremental save sees the
+    // change
+    QFileInfo info(job.path.toQString());
+    buffer.modified =
+        static_cast<MZ_TIME_T>(info.lastModified().toSecsSinceEpoch());
+
+    QFile file(job.path.toQString());
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        WARN(
+            "Failed to open {} for compression (Error: {})!",
+            job.path,
+            file.errorString());
+        return buffer;
+    }
+
+    auto data = file.readAll();
+    buffer.uncompressedSize = static_cast<mz_uint64>(data.size());
+    buffer.crc32 = static_cast<mz_uint32>(mz_crc32(
+        MZ_CRC32_INIT,
+        reinterpret_cast<const unsigned char*>(data.constData()),
+        static_cast<size_t>(data.size())));
+
+    // Tiny entries aren't worth deflating (miniz makes the same call)
+    if (buffer.level == 0 || data.size() <= 3) {
+        buffer.level = 0;
+        buffer.data = std::move(data);
+        buffer.ok = true;
+        return buffer;
+    }
+
+    // Negative window bits means a raw deflate stream (no zlib header), which
+    // is what zip entries hold
+    auto flags = tdefl_create_comp_flags_from_zip_params(
+        buffer.level,
+        -MZ_DEFAULT_WINDOW_BITS,
+        MZ_DEFAULT_STRATEGY);
+
+    size_t out_len = 0;
+    auto out = tdefl_compress_mem_to_heap(
+        data.constData(),
+        static_cast<size_t>(data.size()),
+        &out_len,
+        static_cast<int>(flags));
+
+    if (!out) {
+        WARN("Failed to deflate {}!", job.path);
+        return buffer;
+    }
+
+    buffer.data = QByteArray(static_cast<const char*>(out), out_len);
+    mz_free(out);
+    buffer.ok = true;
+
+    return buffer;
+}
+
+// Deflates jobs in parallel. Results are in the same order as jobs
+inline QList<Buffer> deflateAll(const QList<Job>& jobs)
+{
+    if (jobs.isEmpty()) return {};
+    if (jobs.size() == 1) return { deflate(jobs.first()) };
+
+    return QtConcurrent::blockingMapped(jobs, [](const Job& job) {
+        return deflate(job);
+    });
+}
+
+// Appends a precompressed buffer. Must be called from the thread that owns
+// the writer
+inline bool append(mz_zip_archive* zip, const Buffer& buffer)
+{
+    if (!buffer.ok) return false;
+
+    auto modified = buffer.modified;
+
+    if (buffer.level == 0) {
+        // miniz computes size and CRC itself for uncompressed input
+        return mz_zip_writer_add_mem_ex_v2(
+            zip,
+            buffer.name.c_str(),
+            buffer.data.constData(),
+            static_cast<size_t>(buffer.data.size()),
+            nullptr,
+            0,
+            0,
+            0,
+            0,
+            &modified,
+            nullptr,
+            0,
+            nullptr,
+            0);
+    }
+
+    return mz_zip_writer_add_mem_ex_v2(
+        zip,
+        buffer.name.c_str(),
+        buffer.data.constData(),
+        static_cast<size_t>(buffer.data.size()),
+        nullptr,
+        0,
+        static_cast<mz_uint>(buffer.level) | MZ_ZIP_FLAG_COMPRESSED_DATA,
+        buffer.uncompressedSize,
+        buffer.crc32,
+        &modified,
+        nullptr,
+        0,
+        nullptr,
+        0);
+}
+
+} // namespace Hearth::Nbx::Deflate
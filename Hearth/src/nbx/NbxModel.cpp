@@ -12,7 +12,6 @@
 
 #include "nbx/NbxModel.h"
 
-#include <QDomElement>
 #include <QFont>
 #include <QIcon>
 #include <QModelIndex>
@@ -22,8 +21,9 @@
 
 #include "core/Application.h"
 #include "core/Debug.h"
-#include "nbx/Nbx.h"
+#include "core/Files.h"
 #include "nbx/NbxModelIcons.h"
+#include "nbx/NbxTree.h"
 
 namespace Hearth {
 
@@ -34,17 +34,17 @@ QVariant NbxModel::data(const QModelIndex& index, int role) const
 {
     if (!index.isValid()) return {};
 
-    auto element = elementAt_(index);
-    if (element.isNull()) return {};
+    auto node = nodeAt_(index);
+    if (!tree_.isValid(node)) return {};
 
     switch (role) {
     case Qt::DisplayRole: {
-        auto display_name = Nbx::Xml::name(element);
+        auto display_name = tree_.name(node);
 
-        if (Nbx::Xml::isFile(element) && Nbx::Xml::isEdited(element)) {
+        if (tree_.isEdited(node)) {
             display_name.prepend(u"* "_s);
         }
-        if (Nbx::Xml::hasEditedDescendant(element)) {
+        if (tree_.hasEditedDescendant(node)) {
             display_name += u" (*)"_s;
         }
 
@@ -52,10 +52,10 @@ QVariant NbxModel::data(const QModelIndex& index, int role) const
     }
 
     case Qt::EditRole:
-        return Nbx::Xml::name(element);
+        return tree_.name(node);
 
     case Qt::FontRole: {
-        if (Nbx::Xml::isFile(element) && Nbx::Xml::isEdited(element)) {
+        if (tree_.isEdited(node)) {
             QFont font{};
             font.setItalic(true);
             return font;
@@ -69,11 +69,11 @@ QVariant NbxModel::data(const QModelIndex& index, int role) const
         // here. When opened, Hearth handles it correctly: it would fail a
         // magic byte check and fall through to plain text
     case Qt::DecorationRole: {
-        if (Nbx::Xml::isVirtualFolder(element)) {
+        if (tree_.isVirtualFolder(node)) {
             return NbxModelIcons::folder();
 
-        } else if (Nbx::Xml::isFile(element)) {
-            auto type = Files::fromPath(Nbx::Xml::relPath(element));
+        } else if (tree_.isFile(node)) {
+            auto type = Files::fromPath(tree_.relPath(node));
             return NbxModelIcons::file(type);
         }
 
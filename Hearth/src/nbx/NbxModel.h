@@ -13,25 +13,30 @@
 #pragma once
 
 #include <QAbstractItemModel>
-#include <QDomDocument>
-#include <QDomElement>
+#include <QByteArray>
 #include <QHash>
+#include <QHashFunctions>
 #include <QIcon>
+#include <QList>
 #include <QMimeData>
 #include <QModelIndex>
 #include <QModelIndexList>
 #include <QObject>
+#include <QPair>
+#include <QSet>
 #include <QString>
 #include <QStringList>
+#include <QUuid>
 #include <QVariant>
+#include <QXmlStreamWriter>
 
-#include <Coco/Bool.h>
 #include <Coco/Path.h>
 
 #include "core/Debug.h"
 #include "core/Files.h"
+#include "core/Time.h"
 #include "nbx/Nbx.h"
-#include "nbx/NbxModelCache.h"
+#include "nbx/NbxTree.h"
 
 namespace Hearth {
 
@@ -40,8 +45,9 @@ namespace Hearth {
 //
 // Qt Model/View adapter for .hearthx virtual directory structure.
 //
-// Owns the internal QDomDocument. Public methods return FileInfo structs, never
-// raw DOM elements. Uses Nbx::Xml helpers internally for DOM operations.
+// Owns the NbxTree. Public methods return FileInfo structs, never node IDs.
+// Model indexes carry node IDs as their internal IDs, which stay valid for as
+// long as the node exists, no matter where it moves
 //
 // TODO: Double clicking on files should maybe not expand (if they have
 // children), since they also open with double clicks?
@@ -55,14 +61,6 @@ public:
         Coco::Path relPath{};
         QString name{};
 
-        FileInfo(const QDomElement& element)
-            : relPath(Nbx::Xml::relPath(element))
-            , name(Nbx::Xml::name(element))
-        {
-        }
-
-        FileInfo() = default;
-
         // TODO: Could take workingDir param and concat path and check exists?
         bool isValid() const { return !relPath.isEmpty() && !name.isEmpty(); }
     };
@@ -78,9 +76,10 @@ public:
     void load(const Coco::Path& workingDir)
     {
         beginResetModel();
-        dom_ = Nbx::Xml::makeDom(workingDir);
-        domSnapshot_ = dom_.toString();
-        cache_.clear();
+        tree_.read(Nbx::Xml::readManifest(workingDir));
+        pendingIndicators_.clear();
+        structureHash_ = subtreeHash_(NbxTree::ROOT);
+        snapshot_ = structureHash_;
         endResetModel();
 
         emit domChanged();
@@ -88,76 +87,65 @@ public:
 
     void write(const Coco::Path& workingDir) const
     {
-        Nbx::Xml::writeManifest(workingDir, dom_);
-        INFO("DOM written to manifest: {}", dom_.toString());
+        Nbx::Xml::writeManifest(workingDir, [&](QXmlStreamWriter& xml) {
+            tree_.write(xml);
+        });
     }
 
-    void resetSnapshot() { domSnapshot_ = dom_.toString(); }
+    // Serialized manifest, for archiving without touching the working copy.
+    // Byte-identical to what write puts on disk
+    QByteArray manifest() const { return tree_.write(); }
 
-    bool isModified() const
-    {
-        // As dumb as it might look, this approach allows us to revert to an
-        // unmodified state when appropriate, given we don't (yet?) have
-        // Workspace-level commands (like Ctrl+Z outside an editor to undo a
-        // file rename). We may want to change this in future, but I believe the
-        // following is somewhat compelling:
-        // - QDomDocument::toString() is deterministic for the same structure
-        // - Element/attribute order is preserved
-        // - Whitespace handling is consistent
-        return domSnapshot_ != dom_.toString();
-    }
+    // Opaque record of the current structure. A save in progress takes one up
+    // front and passes it back to resetSnapshot once the archive is written,
+    // so changes made during the save still count as modifications
+    using Snapshot = quint64;
 
-    QModelIndex notebookIndex() const
-    {
-        auto notebook = Nbx::Xml::notebookElement(dom_);
-        return indexFromElement_(notebook);
-    }
+    Snapshot snapshot() const noexcept { return structureHash_; }
 
-    QModelIndex trashIndex() const
-    {
-        auto trash = Nbx::Xml::trashElement(dom_);
-        return indexFromElement_(trash);
-    }
+    void resetSnapshot() noexcept { snapshot_ = structureHash_; }
+    void resetSnapshot(Snapshot snapshot) noexcept { snapshot_ = snapshot; }
 
-    bool hasTrash() const
+    bool isModified() const noexcept
     {
-        return !Nbx::Xml::trashElement(dom_).firstChildElement().isNull();
+        // The structure hash is a function of the structure alone, not of the
+        // edits that produced it, so reverting an edit (e.g., renaming a file
+        // back) reverts to unmodified. We don't (yet?) have Workspace-level
+        // commands (like Ctrl+Z outside an editor to undo a file rename), so
+        // this matters. See structureHash_
+        return snapshot_ != structureHash_;
     }
 
+    QModelIndex notebookIndex() const { return indexOf_(tree_.notebook()); }
+    QModelIndex trashIndex() const { return indexOf_(tree_.trash()); }
+    bool hasTrash() const { return tree_.childCount(tree_.trash()) > 0; }
+
     void setFileEdited(const QString& uuid, bool edited)
     {
-        auto element = findElementByUuid_(uuid);
+        auto node = tree_.find(uuid);
 
-        if (element.isNull()) {
+        if (node == NbxTree::NONE) {
             WARN("Cannot find element with UUID: {}", uuid);
             return;
         }
 
-        if (!Nbx::Xml::isFile(element)) return;
-        if (Nbx::Xml::isEdited(element) == edited) return;
+        if (!tree_.isFile(node)) return;
+        if (tree_.isEdited(node) == edited) return;
+
+        auto indicators = indicatorsAbove_(node);
 
-        Nbx::Xml::setEdited(element, edited);
+        unhash_(node);
+        tree_.setEdited(node, edited);
+        rehash_(node);
 
-        auto index = indexFromElement_(element);
+        auto index = indexOf_(node);
 
         if (index.isValid()) {
             emit dataChanged(index, index, { Qt::DisplayRole, Qt::FontRole });
         }
 
-        // Notify ancestors so (*) indicators update
-        auto ancestor = element.parentNode().toElement();
-
-        while (!ancestor.isNull() && ancestor != dom_.documentElement()) {
-            auto ancestor_index = indexFromElement_(ancestor);
-
-            if (ancestor_index.isValid())
-                emit dataChanged(
-                    ancestor_index,
-                    ancestor_index,
-                    { Qt::DisplayRole });
-
-            ancestor = ancestor.parentNode().toElement();
-        }
+        // Ancestors whose (*) indicator flipped
+        queueIndicatorUpdates_(indicators);
 
         emit domChanged();
     }
@@ -165,19 +153,19 @@ public:
     bool isFile(const QModelIndex& index) const
     {
         if (!index.isValid()) return false;
-        return Nbx::Xml::isFile(elementAt_(index));
+        return tree_.isFile(nodeAt_(index));
     }
 
     bool isVirtualFolder(const QModelIndex& index) const
     {
         if (!index.isValid()) return false;
-        return Nbx::Xml::isVirtualFolder(elementAt_(index));
+        return tree_.isVirtualFolder(nodeAt_(index));
     }
 
     FileInfo fileInfoAt(const QModelIndex& index) const
     {
         if (!index.isValid()) return {};
-        return elementAt_(index);
+        return fileInfo_(nodeAt_(index));
     }
 
     // Parent/index is included
@@ -185,11 +173,11 @@ public:
     {
         if (!index.isValid()) return {};
 
-        auto element = elementAt_(index);
-        if (element.isNull()) return {};
-
         QList<FileInfo> infos{};
-        collectFileInfosRecursive_(element, infos);
+        tree_.visit(nodeAt_(index), [&](NbxTree::Id node) {
+            if (tree_.isFile(node)) infos << fileInfo_(node);
+        });
+
         return infos;
     }
 
@@ -199,14 +187,24 @@ public:
         const Coco::Path& workingDir,
         const QModelIndex& parentIndex = {})
     {
-        auto element =
-            Nbx::Xml::addNewFile(fileType, extension, workingDir, dom_);
-        if (element.isNull()) return {};
+        auto uuid = QUuid::createUuid();
+        auto ext =
+            extension.isEmpty() ? Files::canonicalExt(fileType) : extension;
 
-        auto parent = resolveParent_(parentIndex);
-        insertElement_(element, parent);
+        if (!Nbx::Xml::makeContentFile(
+                workingDir,
+                uuid.toString(QUuid::WithoutBraces),
+                ext))
+            return {};
+
+        auto node = tree_.create(
+            NbxTree::File,
+            Nbx::Internal::XML_NAME_ATTR_FILE_DEF_,
+            uuid,
+            ext);
 
-        return indexFromElement_(element);
+        insertNode_(node, resolveParent_(parentIndex));
+        return indexOf_(node);
     }
 
     QModelIndex addNewFile(
@@ -219,115 +217,114 @@ public:
 
     QModelIndex addNewVirtualFolder(const QModelIndex& parentIndex = {})
     {
-        auto element = Nbx::Xml::addVirtualFolder(dom_);
-        if (element.isNull()) return {};
-
-        auto parent = resolveParent_(parentIndex);
-        insertElement_(element, parent);
+        auto node = tree_.create(
+            NbxTree::VirtualFolder,
+            Nbx::Internal::XML_NAME_ATTR_DIR_DEF_,
+            QUuid::createUuid());
 
-        return indexFromElement_(element);
+        insertNode_(node, resolveParent_(parentIndex));
+        return indexOf_(node);
     }
 
     void moveToTrash(const QModelIndex& index)
     {
         if (!index.isValid()) return;
 
-        auto element = elementAt_(index);
-        if (element.isNull()) return;
+        auto node = nodeAt_(index);
+        if (!tree_.isValid(node)) return;
 
         // Store original parent's UUID for potential restore
-        auto parent = element.parentNode().toElement();
-        auto parent_uuid = Nbx::Xml::uuid(parent);
-        if (!parent_uuid.isEmpty()) {
-            Nbx::Xml::setRestoreParentUuid(element, parent_uuid);
+        auto parent_uuid = tree_.uuid(tree_.parent(node));
+        if (!parent_uuid.isNull()) {
+            unhash_(node);
+            tree_.setRestoreParent(node, parent_uuid);
+            rehash_(node);
         }
 
-        auto trash = Nbx::Xml::trashElement(dom_);
-        moveElement_(element, trash, -1);
+        moveNode_(node, tree_.trash(), -1);
     }
 
     QModelIndex moveToNotebook(const QModelIndex& index)
     {
         if (!index.isValid()) return {};
 
-        auto element = elementAt_(index);
-        if (element.isNull()) return {};
+        auto node = nodeAt_(index);
+        if (!tree_.isValid(node)) return {};
 
         // Try to find original parent
-        auto old_parent_uuid = Nbx::Xml::restoreParentUuid(element);
-        QDomElement destination = Nbx::Xml::notebookElement(dom_);
-
-        if (!old_parent_uuid.isEmpty()) {
-            auto old_parent = findElementByUuid_(old_parent_uuid);
-            if (!old_parent.isNull()
-                && !Nbx::Xml::isInTrash(dom_, old_parent)) {
-                destination = old_parent;
-            }
+        auto old_parent = tree_.find(tree_.restoreParent(node));
+        auto destination = tree_.notebook();
+
+        if (old_parent != NbxTree::NONE
+            && !tree_.isDescendantOf(tree_.trash(), old_parent)) {
+            destination = old_parent;
         }
 
-        Nbx::Xml::clearRestoreParentUuid(element);
+        unhash_(node);
+        tree_.setRestoreParent(node, {});
+        rehash_(node);
 
-        if (!moveElement_(element, destination, -1)) return {};
+        if (!moveNode_(node, destination, -1)) return {};
 
-        return indexFromElement_(element);
+        return indexOf_(node);
     }
 
     bool remove(const QModelIndex& index)
     {
         if (!index.isValid()) return false;
 
-        auto element = elementAt_(index);
-        if (!isValid_(element)) {
+        auto node = nodeAt_(index);
+        if (!tree_.isAttached(node)) {
             WARN("Removal attempted on invalid element!");
             return false;
         }
 
-        auto parent_element = element.parentNode().toElement();
-        if (parent_element.isNull()) return false;
+        auto parent_node = tree_.parent(node);
+        if (parent_node == NbxTree::NONE) return false;
 
-        auto parent_index = indexFromElement_(parent_element);
-        auto row = cache_.rowOf(element);
+        auto parent_index = indexOf_(parent_node);
+        auto row = tree_.row(node);
+        auto indicators = indicatorsAbove_(node);
 
-        // Purge cache BEFORE removing from DOM (need to traverse children)
-        cache_.purgeSubtree(element);
+        // The next sibling's predecessor changes, too
+        auto next = tree_.nextSibling(node);
+        structureHash_ -= subtreeHash_(node);
+        unhash_(next);
 
         beginRemoveRows(parent_index, row, row);
-        parent_element.removeChild(element);
-        cache_.recordRemoval(parent_element, element);
+        tree_.destroy(node);
         endRemoveRows();
 
+        rehash_(next);
+        queueIndicatorUpdates_(indicators);
+
         emit domChanged();
         return true;
     }
 
     bool clearTrash()
     {
-        auto trash = Nbx::Xml::trashElement(dom_);
+        auto trash = tree_.trash();
 
         ASSERT(
-            isValid_(trash),
+            tree_.isAttached(trash),
             "Trash element is invalid! Something is hella wrong!");
 
-        auto child_count = cache_.childCount(trash);
+        auto child_count = tree_.childCount(trash);
         if (child_count <= 0) return true;
 
-        // Purge cache for all children BEFORE removing from DOM
-        auto child = trash.firstChildElement();
-        while (!child.isNull()) {
-            cache_.purgeSubtree(child);
-            child = child.nextSiblingElement();
-        }
+        for (auto child : tree_.children(trash))
+            structureHash_ -= subtreeHash_(child);
 
-        auto trash_index = trashIndex();
-        beginRemoveRows(trash_index, 0, child_count - 1);
+        auto indicators = indicatorsFrom_(trash);
 
-        // Remove all children from DOM
-        while (!trash.firstChildElement().isNull()) {
-            trash.removeChild(trash.firstChildElement());
-        }
+        beginRemoveRows(trashIndex(), 0, child_count - 1);
+
+        while (tree_.childCount(trash) > 0)
+            tree_.destroy(tree_.childAt(trash, 0));
 
-        cache_.invalidateChildren(trash);
         endRemoveRows();
+        queueIndicatorUpdates_(indicators);
 
         emit domChanged();
         return true;
@@ -335,8 +332,7 @@ public:
 
     int descendantCount(const QModelIndex& index) const
     {
-        auto element = elementAt_(index);
-        return descendantCountRecursive_(element);
+        return tree_.descendantCount(nodeAt_(index));
     }
 
     // TODO: Unused
@@ -362,8 +358,8 @@ public:
     {
         if (!index.isValid()) return false;
 
-        auto element = elementAt_(index);
-        if (element.isNull()) return false;
+        auto node = nodeAt_(index);
+        if (!tree_.isValid(node)) return false;
 
         switch (role) {
         case Qt::EditRole:
@@ -372,10 +368,12 @@ public:
             auto new_name = value.toString();
             if (new_name.isEmpty()) return false;
 
-            Nbx::Xml::rename(element, new_name);
+            unhash_(node);
+            tree_.setName(node, new_name);
+            rehash_(node);
 
             emit dataChanged(index, index, { Qt::DisplayRole, Qt::EditRole });
-            if (Nbx::Xml::isFile(element)) emit fileRenamed({ element });
+            if (tree_.isFile(node)) emit fileRenamed(fileInfo_(node));
             emit domChanged();
 
             return true;
@@ -393,43 +391,22 @@ public:
     {
         if (!hasIndex(row, column, parent)) return {};
 
-        auto parent_element = elementAt_(parent);
-        if (parent_element.isNull()) return {};
-
-        auto child_element = cache_.childAt(parent_element, row);
-        if (child_element.isNull()) return {};
+        auto child = tree_.childAt(nodeAt_(parent), row);
+        if (child == NbxTree::NONE) return {};
 
-        return createIndex(row, column, cache_.idOf(child_element));
+        return createIndex(row, column, static_cast<quintptr>(child));
     }
 
     virtual QModelIndex parent(const QModelIndex& child) const override
     {
         if (!child.isValid()) return {};
-
-        auto child_element = elementAt_(child);
-        if (child_element.isNull()) return {};
-
-        auto parent_element = child_element.parentNode().toElement();
-
-        if (parent_element.isNull()
-            || parent_element == dom_.documentElement()) {
-            return {};
-        }
-
-        return createIndex(
-            cache_.rowOf(parent_element),
-            0,
-            cache_.idOf(parent_element));
+        return indexOf_(tree_.parent(nodeAt_(child)));
     }
 
     virtual int rowCount(const QModelIndex& parent = {}) const override
     {
         if (parent.column() > 0) return 0;
-
-        auto element = elementAt_(parent);
-        if (element.isNull()) return 0;
-
-        return cache_.childCount(element);
+        return tree_.childCount(nodeAt_(parent));
     }
 
     // TODO (maybe)
@@ -462,12 +439,12 @@ public:
         QModelIndex index = indexes.first();
         if (!index.isValid()) return nullptr;
 
-        auto element = elementAt_(index);
-        if (element.isNull()) return nullptr;
+        // Only user elements (with UUIDs) are draggable
+        auto uuid = tree_.uuidString(nodeAt_(index));
+        if (uuid.isEmpty()) return nullptr;
 
-        auto key = NbxModelCache::keyOf(element);
         auto mime_data = new QMimeData{};
-        mime_data->setData(MIME_TYPE_, key.toUtf8());
+        mime_data->setData(MIME_TYPE_, uuid.toUtf8());
 
         return mime_data;
     }
@@ -493,28 +470,18 @@ public:
         if (!data || action != Qt::MoveAction) return false;
         if (!data->hasFormat(MIME_TYPE_)) return false;
 
-        auto key = QString::fromUtf8(data->data(MIME_TYPE_));
-        auto element_id = cache_.idForKey(key);
-
-        if (element_id == 0) {
-            WARN("Drop: unknown element key: {}", key);
-            return false;
-        }
+        auto uuid = QString::fromUtf8(data->data(MIME_TYPE_));
+        auto node = tree_.find(uuid);
 
-        auto element = cache_.elementAt(element_id);
-        if (!isValid_(element)) {
-            WARN("Drop: invalid element for ID: {}", element_id);
-            cache_.clear(NbxModelCache::OnError::Yes);
+        if (node == NbxTree::NONE) {
+            WARN("Drop: unknown element UUID: {}", uuid);
             return false;
         }
 
         // Qt resolves drops on empty TreeView area to the root index
-        // (notebookElement), so this fallback shouldn't be reachable in
-        // practice
-        auto drop_parent = elementAt_(parent);
-        if (drop_parent.isNull()) drop_parent = dom_.documentElement();
-
-        return moveElement_(element, drop_parent, row);
+        // (notebook), so falling back to the tree root (via nodeAt_) shouldn't
+        // happen in practice
+        return moveNode_(node, nodeAt_(parent), row);
     }
 
 signals:
@@ -522,162 +489,192 @@ signals:
     void fileRenamed(const FileInfo& info);
 
 private:
-    COCO_BOOL(AllowOrphaned_)
     static constexpr auto MIME_TYPE_ = "application/x-hearth-nbx-element";
-    QDomDocument dom_{};
-    QString domSnapshot_{};
-    mutable NbxModelCache cache_{};
+    NbxTree tree_{};
+
+    // Sum of every node's contribution (see contribution_). Mutators subtract
+    // the contributions of the nodes they touch and add them back afterward,
+    // so dirty checks are a single comparison
+    quint64 structureHash_ = 0;
+    Snapshot snapshot_ = 0;
+
+    // Folders whose (*) indicator needs repainting, flushed once per event
+    // loop turn (see queueIndicatorUpdates_)
+    QSet<NbxTree::Id> pendingIndicators_{};
 
     void setup_()
     {
         //...
     }
 
-    // All O(1) pointer operations. Should be cheap!
-    bool isValid_(
-        const QDomElement& element,
-        AllowOrphaned_ allowOrphaned = AllowOrphaned_::No) const
+    // A node's contribution covers everything that defines its place in the
+    // structure: kind, attributes, parent, and previous sibling. Descendants
+    // are keyed by UUID, so moving a node only changes its own contribution
+    // and those of its old and new next siblings
+    quint64 contribution_(NbxTree::Id node) const
     {
-        if (element.isNull()) return false;
+        if (!tree_.isValid(node)) return 0;
 
-        if (allowOrphaned) return element.ownerDocument() == dom_;
+        auto hash = qHashMulti(
+            0,
+            static_cast<int>(tree_.kind(node)),
+            tree_.name(node),
+            tree_.keyHash(node),
+            tree_.ext(node),
+            tree_.isEdited(node),
+            tree_.restoreParent(node),
+            tree_.keyHash(tree_.parent(node)),
+            tree_.keyHash(tree_.previousSibling(node)));
 
-        if (element.ownerDocument() != dom_) return false;
-        if (element == dom_.documentElement()) return true;
-        return !element.parentNode().toElement().isNull();
+        // Finalize (splitmix64), so that sums of similar hashes stay spread
+        quint64 mixed = hash;
+        mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebULL;
+        return mixed ^ (mixed >> 31);
     }
 
-    // Returns element for index. Invalid index returns document root
-    QDomElement elementAt_(const QModelIndex& index) const
+    quint64 subtreeHash_(NbxTree::Id node) const
     {
-        if (!index.isValid()) return dom_.documentElement();
+        quint64 hash = 0;
+        tree_.visit(node, [&](NbxTree::Id id) { hash += contribution_(id); });
+        return hash;
+    }
+
+    void unhash_(NbxTree::Id node) { structureHash_ -= contribution_(node); }
+    void rehash_(NbxTree::Id node) { structureHash_ += contribution_(node); }
 
-        auto id = reinterpret_cast<quintptr>(index.internalPointer());
-        return cache_.elementAt(id);
+    // Returns node for index. Invalid index returns the tree root
+    NbxTree::Id nodeAt_(const QModelIndex& index) const
+    {
+        if (!index.isValid()) return NbxTree::ROOT;
+        return static_cast<NbxTree::Id>(index.internalId());
     }
 
-    // Returns parent element, defaulting to document root if index invalid
-    QDomElement resolveParent_(const QModelIndex& parentIndex) const
+    // Returns parent node, defaulting to the tree root if index invalid
+    NbxTree::Id resolveParent_(const QModelIndex& parentIndex) const
     {
-        auto parent = elementAt_(parentIndex);
-        return parent.isNull() ? dom_.documentElement() : parent;
+        auto parent = nodeAt_(parentIndex);
+        return tree_.isValid(parent) ? parent : NbxTree::ROOT;
     }
 
-    // Creates QModelIndex for element. Returns invalid for null/root
-    QModelIndex indexFromElement_(const QDomElement& element) const
+    // Creates QModelIndex for node. Returns invalid for NONE/root
+    QModelIndex indexOf_(NbxTree::Id node) const
     {
-        if (element.isNull() || element == dom_.documentElement()) return {};
+        if (node == NbxTree::ROOT) return {};
 
-        auto row = cache_.rowOf(element);
+        auto row = tree_.row(node);
         if (row < 0) return {};
 
-        return createIndex(row, 0, cache_.idOf(element));
+        return createIndex(row, 0, static_cast<quintptr>(node));
     }
 
-    // Cache is lazily populated during tree traversal; unopened branches won't
-    // be cached yet.
-    QDomElement findElementByUuid_(const QString& uuid) const
+    FileInfo fileInfo_(NbxTree::Id node) const
     {
-        if (uuid.isEmpty()) return {};
-
-        // Check cache first
-        if (cache_.containsKey(uuid)) {
-            auto id = cache_.idForKey(uuid);
-            return cache_.elementAt(id);
-        }
-
-        // Fall back to DOM search
-        return findElementByUuidRecursive_(dom_.documentElement(), uuid);
+        if (!tree_.isFile(node)) return {};
+        return { tree_.relPath(node), tree_.name(node) };
     }
 
-    QDomElement findElementByUuidRecursive_(
-        const QDomElement& parent,
-        const QString& uuid) const
-    {
-        auto child = parent.firstChildElement();
+    // An ancestor's (*) indicator state, captured before a mutation
+    using Indicator_ = QPair<NbxTree::Id, bool>;
 
-        while (!child.isNull()) {
-            if (Nbx::Xml::uuid(child) == uuid) {
-                cache_.cache(child);
-                return child;
-            }
+    // Indicator states of node and its ancestors, up to (not including) the
+    // root
+    QList<Indicator_> indicatorsFrom_(NbxTree::Id node) const
+    {
+        QList<Indicator_> indicators{};
 
-            auto found = findElementByUuidRecursive_(child, uuid);
-            if (!found.isNull()) return found;
+        for (; node != NbxTree::NONE && node != NbxTree::ROOT;
+             node = tree_.parent(node))
+            indicators << Indicator_{ node, tree_.hasEditedDescendant(node) };
 
-            child = child.nextSiblingElement();
-        }
+        return indicators;
+    }
 
-        return {};
+    QList<Indicator_> indicatorsAbove_(NbxTree::Id node) const
+    {
+        return indicatorsFrom_(tree_.parent(node));
     }
 
-    void collectFileInfosRecursive_(
-        const QDomElement& element,
-        QList<FileInfo>& outInfos) const
+    // Queues the captured ancestors whose indicator has since flipped. Counts
+    // only ever change by the same amount all the way up the chain, so only
+    // the nearest ancestors (those crossing zero) actually flip. Queued rows
+    // are flushed on the next event loop turn as one dataChanged range per
+    // parent, so marking many files at once (e.g., on recovery) costs one
+    // repaint per affected branch
+    void queueIndicatorUpdates_(const QList<Indicator_>& indicators)
     {
-        if (element.isNull()) return;
+        auto was_empty = pendingIndicators_.isEmpty();
 
-        if (Nbx::Xml::isFile(element)) outInfos << element;
+        for (const auto& [node, had_edited] : indicators)
+            if (tree_.hasEditedDescendant(node) != had_edited)
+                pendingIndicators_ << node;
 
-        auto child = element.firstChildElement();
-        while (!child.isNull()) {
-            collectFileInfosRecursive_(child, outInfos);
-            child = child.nextSiblingElement();
-        }
+        if (was_empty && !pendingIndicators_.isEmpty())
+            Time::onNextTick(this, [this] { flushIndicatorUpdates_(); });
     }
 
-    int descendantCountRecursive_(const QDomElement& element) const
+    void flushIndicatorUpdates_()
     {
-        auto count = 0;
-        auto child = element.firstChildElement();
+        // Row range per parent
+        QHash<NbxTree::Id, QPair<int, int>> ranges{};
+
+        for (auto node : pendingIndicators_) {
+            if (!tree_.isAttached(node)) continue;
 
-        while (!child.isNull()) {
-            ++count;
-            count += descendantCountRecursive_(child);
-            child = child.nextSiblingElement();
+            auto row = tree_.row(node);
+            auto parent = tree_.parent(node);
+            auto it = ranges.find(parent);
+
+            if (it == ranges.end()) {
+                ranges.insert(parent, { row, row });
+            } else {
+                it->first = qMin(it->first, row);
+                it->second = qMax(it->second, row);
+            }
         }
 
-        return count;
-    }
+        pendingIndicators_.clear();
 
-    bool isDescendantOf_(
-        const QDomElement& ancestor,
-        const QDomElement& element) const
-    {
-        if (ancestor.isNull() || element.isNull()) return false;
+        for (auto it = ranges.cbegin(); it != ranges.cend(); ++it) {
+            auto parent = it.key();
+            auto [first, last] = it.value();
+            auto parent_index = indexOf_(parent);
 
-        auto current = element.parentNode().toElement();
-        while (!current.isNull()) {
-            if (current == ancestor) return true;
-            current = current.parentNode().toElement();
+            emit dataChanged(
+                index(first, 0, parent_index),
+                index(last, 0, parent_index),
+                { Qt::DisplayRole });
         }
+    }
 
-        return false;
+    // For logging
+    QString label_(NbxTree::Id node) const
+    {
+        auto uuid = tree_.uuidString(node);
+        if (!uuid.isEmpty()) return uuid;
+        return QString::number(static_cast<int>(tree_.kind(node)));
     }
 
-    // The parent element parameters must be by-value because
-    // `dom_.documentElement()` returns a temporary (rvalue). Non-const
-    // references (`QDomElement&`) cannot bind to temporaries
-    bool
-    moveElement_(const QDomElement& element, QDomElement newParent, int newRow)
+    bool moveNode_(NbxTree::Id node, NbxTree::Id newParent, int newRow)
     {
         // Both must be attached to tree
-        if (!isValid_(element) || !isValid_(newParent)) {
+        if (!tree_.isAttached(node) || !tree_.isAttached(newParent)) {
             WARN("Move attempted on invalid element(s)!");
             return false;
         }
 
-        auto current_parent = element.parentNode().toElement();
-        if (current_parent.isNull()) return false;
+        auto current_parent = tree_.parent(node);
+        if (current_parent == NbxTree::NONE) return false;
 
         // Prevent moving into own subtree
-        if (isDescendantOf_(element, newParent)) return false;
+        if (node == newParent || tree_.isDescendantOf(node, newParent))
+            return false;
 
-        auto src_parent_index = indexFromElement_(current_parent);
-        auto source_row = cache_.rowOf(element);
-        auto dest_parent_index = indexFromElement_(newParent);
+        auto src_parent_index = indexOf_(current_parent);
+        auto source_row = tree_.row(node);
+        auto dest_parent_index = indexOf_(newParent);
 
-        auto dest_child_count = cache_.childCount(newParent);
+        auto dest_child_count = tree_.childCount(newParent);
         auto dest_row = (newRow < 0) ? dest_child_count : newRow;
 
         // No-op check
@@ -685,19 +682,19 @@ private:
 
         INFO(
             "Moving element: {}\n\tFrom: {} row {}\n\tTo: {} row {}",
-            element,
-            current_parent,
+            label_(node),
+            label_(current_parent),
             source_row,
-            newParent,
+            label_(newParent),
             dest_row);
 
         // Calculate adjusted rows for Qt's beginMoveRows semantics
         auto dest_row_for_begin = dest_row;
-        auto dest_row_for_dom = dest_row;
+        auto dest_row_for_tree = dest_row;
 
         if (current_parent == newParent && dest_row > source_row) {
             ++dest_row_for_begin; // Qt expects pre-removal index
-            --dest_row_for_dom; // DOM needs post-removal index
+            --dest_row_for_tree; // Tree needs post-removal index
         }
 
         if (!beginMoveRows(
@@ -709,97 +706,52 @@ private:
             return false;
         }
 
-        // For same-parent moves, cache the sibling BEFORE any modifications
-        // (indices shift after removal)
-        QDomElement insert_before_sibling{};
-        if (current_parent == newParent) {
-            int sibling_index =
-                (dest_row > source_row) ? dest_row : dest_row_for_dom;
-            if (sibling_index < dest_child_count) {
-                insert_before_sibling =
-                    cache_.childAt(newParent, sibling_index);
-            }
-        } else {
-            if (dest_row_for_dom < dest_child_count) {
-                insert_before_sibling =
-                    cache_.childAt(newParent, dest_row_for_dom);
-            }
-        }
+        // Both the old and new ancestors' (*) indicators may flip
+        auto indicators = indicatorsAbove_(node) + indicatorsFrom_(newParent);
 
-        // DOM modification
-        current_parent.removeChild(element);
+        // The node and both its old and new next siblings get new
+        // predecessors. Unhash before the tree changes
+        auto old_next = tree_.nextSibling(node);
+        unhash_(node);
+        unhash_(old_next);
 
-        if (insert_before_sibling.isNull()) {
-            newParent.appendChild(element);
-        } else {
-            newParent.insertBefore(element, insert_before_sibling);
-        }
+        tree_.take(node);
 
-        // Cache update
-        cache_.recordMove(current_parent, newParent, element, dest_row_for_dom);
+        auto new_next = tree_.childAt(newParent, dest_row_for_tree);
+        if (new_next == old_next) new_next = NbxTree::NONE;
+        unhash_(new_next);
+
+        tree_.insert(node, newParent, dest_row_for_tree);
+
+        rehash_(node);
+        rehash_(old_next);
+        rehash_(new_next);
 
         endMoveRows();
+        queueIndicatorUpdates_(indicators);
         emit domChanged();
 
         return true;
     }
 
-    // The parent element parameters must be by-value because
-    // `dom_.documentElement()` returns a temporary (rvalue). Non-const
-    // references (`QDomElement&`) cannot bind to temporaries
-    void insertElement_(const QDomElement& element, QDomElement parentElement)
+    // TODO: Expand parent if applicable after appending (probably a view op)
+    void insertNode_(NbxTree::Id node, NbxTree::Id parentNode)
     {
-        if (!isValid_(element, AllowOrphaned_::Yes)
-            || !isValid_(parentElement)) {
+        if (!tree_.isValid(node) || !tree_.isAttached(parentNode)) {
             WARN("Insertion attempted with invalid element(s)!");
+            tree_.destroy(node);
             return;
         }
 
-        auto parent_index = indexFromElement_(parentElement);
-        auto row = cache_.childCount(parentElement);
+        auto row = tree_.childCount(parentNode);
 
-        beginInsertRows(parent_index, row, row);
-
-        parentElement.appendChild(element);
-        cache_.recordInsertion(parentElement, element);
+        beginInsertRows(indexOf_(parentNode), row, row);
+        tree_.insert(node, parentNode);
+        structureHash_ += subtreeHash_(node);
         endInsertRows();
 
         emit domChanged();
     }
-
-    // The parent element parameters must be by-value because
-    // `dom_.documentElement()` returns a temporary (rvalue). Non-const
-    // references (`QDomElement&`) cannot bind to temporaries
-    // TODO: Expand parent if applicable after appending (probably a view op)
-    void insertElements_(
-        const QList<QDomElement>& elements,
-        QDomElement parentElement)
-    {
-        if (elements.isEmpty()) return;
-
-        if (!isValid_(parentElement)) {
-            WARN("Insertion attempted on invalid parent!");
-            return;
-        }
-
-        auto parent_index = indexFromElement_(parentElement);
-        auto row = cache_.childCount(parentElement);
-
-        for (const auto& element : elements) {
-            if (!isValid_(element, AllowOrphaned_::Yes)) {
-                WARN("Insertion attempted with invalid element!");
-                continue;
-            }
-
-            beginInsertRows(parent_index, row, row);
-            parentElement.appendChild(element);
-            cache_.recordInsertion(parentElement, element);
-            endInsertRows();
-            ++row;
-        }
-
-        emit domChanged();
-    }
 };
 
 } // namespace Hearth
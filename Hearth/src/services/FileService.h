@@ -17,6 +17,7 @@
 #include <QByteArray>
 #include <QFileSystemWatcher>
 #include <QHash>
+#include <QIODevice>
 #include <QList>
 #include <QObject>
 #include <QSet>
@@ -36,6 +37,7 @@
 #include "models/RawFileModel.h"
 #include "models/TextFileModel.h"
 #include "services/AbstractService.h"
+#include "settings/Ini.h"
 #include "ui/Window.h"
 #include "views/AbstractFileView.h"
 #include "workspaces/Bus.h"
@@ -80,6 +82,13 @@ public:
         afterModelCreatedHook,
         setAfterModelCreatedHook)
 
+    // Called with the path before opening it, so the path can be made
+    // available first (e.g., extracted from a Notebook archive)
+    DECLARE_HOOK(
+        std::function<void(const Coco::Path&)>,
+        beforeOpenHook,
+        setBeforeOpenHook)
+
     // TODO: Could use a handle (would that be too overly complex) instead of
     // passing models around?
 
@@ -164,7 +173,10 @@ public:
         const QString& title = {})
     {
         if (!window) return;
-        if (path.isEmpty() || !path.isFile() || !path.exists()) return;
+        if (path.isEmpty()) return;
+
+        if (beforeOpenHook_) beforeOpenHook_(path);
+        if (!path.isFile() || !path.exists()) return;
 
         // Check if model already exists and re-ready
         if (auto existing_model = pathToFileModel_[path]) {
@@ -242,6 +254,18 @@ protected:
                 fileModel->setModified(false);
                 INFO("File model [{}] reloaded from disk", fileModel);
             });
+
+        connect(
+            bus,
+            &Bus::settingChanged,
+            this,
+            [this](const QString& key, const QVariant& value) {
+                if (key != Ini::Keys::EDITOR_UNDO_MEMORY) return;
+
+                for (auto& model : fileModels_)
+                    if (auto text_model = qobject_cast<TextFileModel*>(model))
+                        setUndoBudget_(text_model, value.toInt());
+            });
     }
 
 private:
@@ -369,9 +393,21 @@ private:
     {
         if (path.isEmpty() || !path.exists()) return nullptr;
 
-        auto model = new TextFileModel(path, this);
-        model->setData(Io::read(path));
+        auto data = Io::read(path);
+        auto storage = TextFileModel::storageFor(data.size());
+        auto model = new TextFileModel(path, storage, this);
+
+        connect(
+            model,
+            &TextFileModel::loadProgressChanged,
+            this,
+            [this, model](int percent) {
+                emit bus->fileModelLoadProgressChanged(model, percent);
+            });
+
+        model->setData(data);
         model->setModified(false); // Pretty important!
+        setUndoBudget_(model);
 
         // TODO: Handle document is nullptr?
 
@@ -381,6 +417,7 @@ private:
     AbstractFileModel* newOffDiskTextFileModel_(Files::Type plainTextFileType)
     {
         auto model = new TextFileModel(plainTextFileType, this);
+        setUndoBudget_(model);
         registerModel_(model);
         /// TODO BA
         if (afterModelCreatedHook_) afterModelCreatedHook_(model);
@@ -411,6 +448,21 @@ private:
         return model;
     }
 
+    void setUndoBudget_(TextFileModel* model, int mebibytes = -1)
+    {
+        if (mebibytes < 0)
+            mebibytes = bus->call<int>(
+                Bus::GET_SETTING,
+                { { "key", Ini::Keys::EDITOR_UNDO_MEMORY } });
+
+        mebibytes = qBound(
+            Ini::Limits::EDITOR_UNDO_MEMORY_MIN,
+            mebibytes,
+            Ini::Limits::EDITOR_UNDO_MEMORY_MAX);
+
+        model->setUndoBudget(qint64(mebibytes) * 1024 * 1024);
+    }
+
     void connectNewModel_(AbstractFileModel* fileModel)
     {
         connect(
@@ -446,8 +498,9 @@ private:
         // during a stat check
         watcher_->removePath(q_path);
 
-        auto data = model->data();
-        auto success = Io::write(data, path);
+        auto success = Io::write(path, [model](QIODevice& device) {
+            return model->write(device);
+        });
 
         // Re-add to watcher. recentlyWritten_ guards against a spurious
         // fileChanged signal that some platforms emit on re-add
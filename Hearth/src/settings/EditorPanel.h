@@ -54,6 +54,8 @@ private:
     QCheckBox* selectionHandlesCheck_ = new QCheckBox(this);
     ControlField<DisplaySlider>* leftRightMargin_ =
         new ControlField<DisplaySlider>(FieldKind::Label, this);
+    ControlField<DisplaySlider>* undoMemory_ =
+        new ControlField<DisplaySlider>(FieldKind::LabelAndInfo, this);
 
     void setup_(const Ini::Map& values)
     {
@@ -114,6 +116,15 @@ private:
             Ini::Limits::EDITOR_LR_MARGIN_MAX);
         lr_margin_slider->setValue(values[Ini::Keys::EDITOR_LR_MARGIN].toInt());
 
+        undoMemory_->setText(Tr::editorPanelUndoMemory());
+        undoMemory_->setInfo(Tr::editorPanelUndoMemoryTooltip());
+        auto undo_memory_slider = undoMemory_->control();
+        undo_memory_slider->setRange(
+            Ini::Limits::EDITOR_UNDO_MEMORY_MIN,
+            Ini::Limits::EDITOR_UNDO_MEMORY_MAX);
+        undo_memory_slider->setValue(
+            values[Ini::Keys::EDITOR_UNDO_MEMORY].toInt());
+
         // Layout
         auto layout = groupBox()->layout();
         layout->addWidget(centerOnScrollCheck_);
@@ -125,6 +136,7 @@ private:
         layout->addWidget(lineHighlightCheck_);
         layout->addWidget(selectionHandlesCheck_);
         layout->addWidget(leftRightMargin_);
+        layout->addWidget(undoMemory_);
 
         // Connect
         connectCheckBox(
@@ -144,6 +156,9 @@ private:
             selectionHandlesCheck_,
             Ini::Keys::EDITOR_SELECTION_HANDLES);
         connectDisplaySlider(lr_margin_slider, Ini::Keys::EDITOR_LR_MARGIN);
+        connectDisplaySlider(
+            undo_memory_slider,
+            Ini::Keys::EDITOR_UNDO_MEMORY);
     }
 };
 
@@ -46,6 +46,7 @@ namespace Keys {
     inline const auto EDITOR_LINE_HIGHLIGHT = u"Editor/LineHighlight"_s;
     inline const auto EDITOR_SELECTION_HANDLES = u"Editor/SelectionHandles"_s;
     inline const auto EDITOR_LR_MARGIN = u"Editor/LeftRightMargin"_s;
+    inline const auto EDITOR_UNDO_MEMORY = u"Editor/UndoMemory"_s;
     inline const auto WORD_COUNTER_ACTIVE = u"WordCounter/Active"_s;
     inline const auto WORD_COUNTER_LINE_COUNT = u"WordCounter/LineCount"_s;
     inline const auto WORD_COUNTER_WORD_COUNT = u"WordCounter/WordCount"_s;
@@ -57,6 +58,7 @@ namespace Keys {
     inline const auto WORD_COUNTER_COL_POS = u"WordCounter/ColPos"_s;
     inline const auto COLOR_BAR_ACTIVE = u"ColorBar/Active"_s;
     inline const auto COLOR_BAR_POSITION = u"ColorBar/Position"_s;
+    inline const auto NOTEBOOK_COMPRESSION = u"Notebook/Compression"_s;
 
 } // namespace Keys
 
@@ -79,6 +81,16 @@ namespace Limits {
     constexpr auto EDITOR_LR_MARGIN_MIN = 0;
     constexpr auto EDITOR_LR_MARGIN_MAX = 200;
 
+    // Undo history per large file (MiB) before older steps spill to disk
+    constexpr auto EDITOR_UNDO_MEMORY_MIN = 4;
+    constexpr auto EDITOR_UNDO_MEMORY_DEF = 32;
+    constexpr auto EDITOR_UNDO_MEMORY_MAX = 512;
+
+    // Deflate levels for Notebook text entries (fast to small)
+    constexpr auto NOTEBOOK_COMPRESSION_MIN = 1;
+    constexpr auto NOTEBOOK_COMPRESSION_DEF = 6;
+    constexpr auto NOTEBOOK_COMPRESSION_MAX = 9;
+
 } // namespace Limits
 
 using Map = QHash<QString, QVariant>;
@@ -109,6 +121,7 @@ inline const Map& defaults()
         { Keys::EDITOR_LINE_HIGHLIGHT, false },
         { Keys::EDITOR_SELECTION_HANDLES, false },
         { Keys::EDITOR_LR_MARGIN, 0 },
+        { Keys::EDITOR_UNDO_MEMORY, Limits::EDITOR_UNDO_MEMORY_DEF },
 
         // Word counter
         { Keys::WORD_COUNTER_ACTIVE, false },
@@ -124,6 +137,9 @@ inline const Map& defaults()
         { Keys::COLOR_BAR_ACTIVE, true },
         { Keys::COLOR_BAR_POSITION, qVar(ColorBar::Top) },
 
+        // Notebook
+        { Keys::NOTEBOOK_COMPRESSION, Limits::NOTEBOOK_COMPRESSION_DEF },
+
         // Local (per-Workspace)
         { LocalKeys::NOTEPAD_UNIQUE_TABS, true },
         { LocalKeys::NOTEBOOK_UNIQUE_TABS, true },
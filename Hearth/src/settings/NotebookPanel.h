@@ -0,0 +1,79 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <QComboBox>
+#include <QGroupBox>
+#include <QString>
+#include <QVariant>
+
+#include "core/Debug.h"
+#include "core/Tr.h"
+#include "settings/Ini.h"
+#include "settings/SettingsPanel.h"
+#include "ui/ControlField.h"
+
+namespace Hearth {
+
+// Settings for .hearthx archives. Only Notebooks read these
+class NotebookPanel : public SettingsPanel
+{
+    Q_OBJECT
+
+public:
+    explicit NotebookPanel(const Ini::Map& values, QWidget* parent = nullptr)
+        : SettingsPanel(Tr::notebookPanelTitle(), parent)
+    {
+        setup_(values);
+    }
+
+    virtual ~NotebookPanel() override { TRACER; }
+
+private:
+    ControlField<QComboBox>* compression_ =
+        new ControlField<QComboBox>(FieldKind::Label, this);
+
+    void setup_(const Ini::Map& values)
+    {
+        // Populate
+        auto group_box = groupBox();
+
+        // Images and PDFs are always stored as-is, so this only affects text
+        compression_->setText(Tr::notebookPanelCompression());
+        auto compression_box = compression_->control();
+        compression_box->addItem(
+            Tr::notebookPanelFast(),
+            Ini::Limits::NOTEBOOK_COMPRESSION_MIN);
+        compression_box->addItem(
+            Tr::notebookPanelBalanced(),
+            Ini::Limits::NOTEBOOK_COMPRESSION_DEF);
+        compression_box->addItem(
+            Tr::notebookPanelSmall(),
+            Ini::Limits::NOTEBOOK_COMPRESSION_MAX);
+
+        auto index = compression_box->findData(
+            values[Ini::Keys::NOTEBOOK_COMPRESSION].toInt());
+        compression_box->setCurrentIndex(
+            index < 0 ? compression_box->findData(
+                            Ini::Limits::NOTEBOOK_COMPRESSION_DEF)
+                      : index);
+
+        // Layout
+        group_box->layout()->addWidget(compression_);
+
+        // Connect
+        connectComboBox(compression_box, Ini::Keys::NOTEBOOK_COMPRESSION);
+    }
+};
+
+} // namespace Hearth
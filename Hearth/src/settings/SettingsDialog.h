@@ -28,6 +28,7 @@
 #include "settings/FontPanel.h"
 #include "settings/Ini.h"
 #include "settings/KeyFiltersPanel.h"
+#include "settings/NotebookPanel.h"
 #include "settings/ThemesPanel.h"
 #include "settings/WordCounterPanel.h"
 
@@ -66,6 +67,7 @@ private:
     EditorPanel* editorPanel_ = nullptr;
     WordCounterPanel* wordCounterPanel_ = nullptr;
     ColorBarPanel* colorBarPanel_ = nullptr;
+    NotebookPanel* notebookPanel_ = nullptr;
 
     void setup_(
         const QString& title,
@@ -83,6 +85,7 @@ private:
         editorPanel_ = new EditorPanel(values, this);
         wordCounterPanel_ = new WordCounterPanel(values, this);
         colorBarPanel_ = new ColorBarPanel(values, this);
+        notebookPanel_ = new NotebookPanel(values, this);
 
         auto main_layout = new QHBoxLayout(this);
 
@@ -96,6 +99,7 @@ private:
         col_1->addWidget(keyFiltersPanel_);
         col_1->addWidget(editorPanel_);
         col_1->addWidget(colorBarPanel_);
+        col_1->addWidget(notebookPanel_);
         col_1->addStretch();
 
         main_layout->addLayout(col_0);
@@ -107,7 +111,8 @@ private:
                                                     keyFiltersPanel_,
                                                     editorPanel_,
                                                     wordCounterPanel_,
-                                                    colorBarPanel_ }) {
+                                                    colorBarPanel_,
+                                                    notebookPanel_ }) {
             connect(
                 panel,
                 &SettingsPanel::settingChanged,
@@ -0,0 +1,462 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QPromise>
+#include <QString>
+#include <QStringList>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QtConcurrent>
+
+#include "core/Debug.h"
+#include "core/Time.h"
+#include "core/WordCount.h"
+
+namespace Hearth {
+
+// Live line, word, and char counts for a QTextDocument. Lines and chars are
+// free (blockCount() and characterCount()); words are cached per block in a
+// side table indexed by block number, with the document total kept as a
+// running sum. Each contentsChange recounts only the blocks in the changed
+// range, so an edit costs O(edit) whatever the size of the document. Words
+// never span blocks (a block boundary is always whitespace), so the per-block
+// counts always add up to the whole
+//
+// Full counts (the first, and any change larger than ASYNC_MIN_CHARS_, like a
+// view reattaching) run off the GUI thread. Block text can only be read on
+// the GUI thread, so it's snapshotted there in slices of under a millisecond,
+// one per tick, and the snapshot is counted on the global thread pool. Edits
+// made meanwhile are kept: during the snapshot they patch it, and during the
+// count they're recorded as splices and applied to the result. A larger
+// change starts the count over, canceling the one in flight. Until a full
+// count lands, words() is the last known total and isCounting() is true
+//
+// One instance per document, shared by every WordCounter showing it (see
+// BlockCounts::of). It's the document's child and goes with it
+class BlockCounts : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Returns the document's counts, creating them (and starting a full count)
+    // on first use
+    static BlockCounts* of(QTextDocument* document)
+    {
+        if (!document) return nullptr;
+
+        if (auto counts = document->findChild<BlockCounts*>(
+                Qt::FindDirectChildrenOnly))
+            return counts;
+
+        return new BlockCounts(document);
+    }
+
+    virtual ~BlockCounts() override
+    {
+        TRACER;
+        watcher_->cancel();
+        watcher_->waitForFinished();
+    }
+
+    int lines() const { return document_->blockCount(); }
+    int chars() const { return document_->characterCount() - 1; }
+    int words() const noexcept { return words_; }
+    bool isCounting() const noexcept { return state_ != State_::Ready; }
+
+    // Words in [start, end), or -1 while the block counts aren't current (a
+    // full count is running, or a change hasn't reached them yet). Words
+    // never span blocks, so this is the blocks wholly inside the range, read
+    // from prefix sums of the block counts, plus a count of the partial blocks
+    // at either end. A selection of any size costs two block scans
+    int wordsBetween(int start, int end)
+    {
+        if (isCounting() || document_->blockCount() != blockCount_) return -1;
+        if (start >= end) return 0;
+
+        auto first = document_->findBlock(start);
+        auto last = document_->findBlock(end);
+        if (!first.isValid()) return 0;
+        if (!last.isValid()) last = document_->lastBlock();
+
+        auto head = first.text();
+        auto head_start = qMin(start - first.position(), int(head.size()));
+
+        if (first == last)
+            return WordCount::count(QStringView(head).sliced(
+                head_start,
+                qMin(end - start, int(head.size()) - head_start)));
+
+        auto tail = last.text();
+        auto tail_end = qMin(end - last.position(), int(tail.size()));
+
+        return WordCount::count(QStringView(head).sliced(head_start))
+               + wordsBefore_(last.blockNumber())
+               - wordsBefore_(first.blockNumber() + 1)
+               + WordCount::count(QStringView(tail).first(tail_end));
+    }
+
+signals:
+    void countsChanged();
+    void countingChanged(bool counting);
+
+private:
+    explicit BlockCounts(QTextDocument* document)
+        : QObject(document)
+        , document_(document)
+    {
+        setup_();
+    }
+
+    // Changes (and documents) up to this size are counted on the spot
+    static constexpr auto ASYNC_MIN_CHARS_ = 256 * 1024;
+    static constexpr qint64 SLICE_NSECS_ = 1'000'000;
+    static constexpr auto CANCEL_CHECK_BLOCKS_ = 1024;
+
+    enum class State_
+    {
+        Ready,
+        Snapshotting,
+        Counting
+    };
+
+    struct Result_
+    {
+        QList<int> blockWords{};
+        int words = 0;
+    };
+
+    // An edit made while a full count runs: entries [first, first + removed)
+    // become words
+    struct Splice_
+    {
+        int first;
+        qsizetype removed;
+        QList<int> words;
+    };
+
+    QTextDocument* document_;
+    QFutureWatcher<Result_>* watcher_ = new QFutureWatcher<Result_>(this);
+
+    // Words per block, by block number
+    QList<int> blockWords_{};
+    int words_ = 0;
+
+    // Words in blocks [0, i), by i. Extended on demand and cut back to the
+    // first changed block on each edit, so entries [0, prefixEnd_] are valid
+    QList<int> prefix_{ 0 };
+    qsizetype prefixEnd_ = 0;
+
+    // Block count as of the last change, to tell how many blocks an edit
+    // added or removed
+    int blockCount_ = 0;
+
+    State_ state_ = State_::Ready;
+    bool sliceScheduled_ = false;
+    QStringList snapshot_{}; // Text of blocks [0, size) while snapshotting
+    QList<Splice_> splices_{}; // Edits made while counting
+
+    void setup_()
+    {
+        blockCount_ = document_->blockCount();
+
+        connect(
+            document_,
+            &QTextDocument::contentsChange,
+            this,
+            &BlockCounts::onDocumentContentsChange_);
+
+        connect(
+            watcher_,
+            &QFutureWatcher<Result_>::finished,
+            this,
+            &BlockCounts::onWatcherFinished_);
+
+        recount_();
+    }
+
+    void setState_(State_ state)
+    {
+        auto was_counting = isCounting();
+        state_ = state;
+        if (was_counting != isCounting()) emit countingChanged(isCounting());
+    }
+
+    // Small documents are counted on the spot. Otherwise, drops any full
+    // count in progress and starts another
+    void recount_()
+    {
+        watcher_->cancel();
+        snapshot_.clear();
+        splices_.clear();
+
+        if (document_->characterCount() <= ASYNC_MIN_CHARS_) {
+            blockWords_ =
+                countBlocks_(document_->begin(), document_->lastBlock());
+            words_ = sum_(blockWords_);
+            invalidatePrefix_(0);
+            setState_(State_::Ready);
+            emit countsChanged();
+            return;
+        }
+
+        setState_(State_::Snapshotting);
+        scheduleSlice_();
+    }
+
+    void scheduleSlice_()
+    {
+        if (sliceScheduled_) return;
+
+        sliceScheduled_ = true;
+        Time::onNextTick(this, [this] {
+            sliceScheduled_ = false;
+            snapshotSlice_();
+        });
+    }
+
+    void snapshotSlice_()
+    {
+        if (state_ != State_::Snapshotting) return;
+
+        QElapsedTimer timer{};
+        timer.start();
+
+        for (auto block = document_->findBlockByNumber(snapshot_.size());
+             block.isValid();
+             block = block.next()) {
+            if (timer.nsecsElapsed() >= SLICE_NSECS_) {
+                scheduleSlice_();
+                return;
+            }
+
+            snapshot_ << block.text();
+        }
+
+        startCount_();
+    }
+
+    void startCount_()
+    {
+        auto task = [snapshot = std::move(snapshot_)](
+                        QPromise<Result_>& promise) {
+            Result_ result{};
+            result.blockWords.reserve(snapshot.size());
+
+            for (auto i = 0; i < snapshot.size(); ++i) {
+                if (i % CANCEL_CHECK_BLOCKS_ == 0 && promise.isCanceled())
+                    return;
+
+                auto words = WordCount::count(snapshot[i]);
+                result.blockWords << words;
+                result.words += words;
+            }
+
+            promise.addResult(result);
+        };
+
+        snapshot_ = {};
+        setState_(State_::Counting);
+        watcher_->setFuture(QtConcurrent::run(task));
+    }
+
+    QList<int> countBlocks_(const QTextBlock& first, const QTextBlock& last)
+    {
+        QList<int> words{};
+
+        for (auto block = first; block.isValid(); block = block.next()) {
+            words << WordCount::count(block.text());
+            if (block == last) break;
+        }
+
+        return words;
+    }
+
+    static int sum_(const QList<int>& words)
+    {
+        auto total = 0;
+        for (auto count : words)
+            total += count;
+
+        return total;
+    }
+
+    // Replaces items [first, first + removed) of list with items
+    template <typename T>
+    static void replaceRange_(
+        QList<T>& list,
+        qsizetype first,
+        qsizetype removed,
+        const QList<T>& items)
+    {
+        auto shared = qMin(removed, items.size());
+
+        for (qsizetype i = 0; i < shared; ++i)
+            list[first + i] = items[i];
+
+        if (items.size() > removed)
+            list.insert(first + shared, items.size() - shared, T{});
+        else if (removed > items.size())
+            list.remove(first + shared, removed - shared);
+
+        for (auto i = shared; i < items.size(); ++i)
+            list[first + i] = items[i];
+    }
+
+    // Replaces the counts of blocks [first, first + removed), keeping the
+    // total
+    void splice_(int first, qsizetype removed, const QList<int>& words)
+    {
+        for (auto i = first; i < first + removed; ++i)
+            words_ -= blockWords_[i];
+
+        replaceRange_(blockWords_, first, removed, words);
+        words_ += sum_(words);
+        invalidatePrefix_(first);
+    }
+
+    void invalidatePrefix_(qsizetype from)
+    {
+        prefix_.resize(blockWords_.size() + 1);
+        prefixEnd_ = qMin(prefixEnd_, from);
+    }
+
+    int wordsBefore_(int block)
+    {
+        for (; prefixEnd_ < block; ++prefixEnd_)
+            prefix_[prefixEnd_ + 1] = prefix_[prefixEnd_]
+                                      + blockWords_[prefixEnd_];
+
+        return prefix_[block];
+    }
+
+    // The snapshot holds the current text of blocks [0, size). Blocks the
+    // edit changed are replaced if the edit lies inside it, and dropped (to be
+    // read again) if it runs past its end
+    void patchSnapshot_(
+        const QTextBlock& first,
+        const QTextBlock& last,
+        qsizetype oldSize)
+    {
+        auto first_number = first.blockNumber();
+        if (first_number >= snapshot_.size()) return;
+
+        if (first_number + oldSize > snapshot_.size()) {
+            snapshot_.resize(first_number);
+            return;
+        }
+
+        QStringList texts{};
+        for (auto block = first; block.isValid(); block = block.next()) {
+            texts << block.text();
+            if (block == last) break;
+        }
+
+        replaceRange_<QString>(snapshot_, first_number, oldSize, texts);
+    }
+
+private slots:
+    void onWatcherFinished_()
+    {
+        auto future = watcher_->future();
+
+        // A canceled count may finish after its replacement started
+        if (state_ != State_::Counting || future.isCanceled()
+            || future.resultCount() < 1)
+            return;
+
+        auto result = future.result();
+        blockWords_ = result.blockWords;
+        words_ = result.words;
+        invalidatePrefix_(0);
+
+        for (auto& splice : splices_) {
+            if (splice.first + splice.removed > blockWords_.size()) {
+                WARN("Block counts out of step with document! Recounting");
+                recount_();
+                return;
+            }
+
+            splice_(splice.first, splice.removed, splice.words);
+        }
+
+        splices_.clear();
+        setState_(State_::Ready);
+        emit countsChanged();
+    }
+
+    // The changed range is [pos, pos + added) in the new text. Blocks before
+    // its first block and after its last are untouched, so the old entries
+    // between them (shifted by the change in block count) are swapped for
+    // fresh counts. The removed count isn't needed, which is as well, since
+    // Qt doesn't always report it exactly (setPlainText, for one)
+    void onDocumentContentsChange_(
+        int position,
+        [[maybe_unused]] int charsRemoved,
+        int charsAdded)
+    {
+        auto first = document_->findBlock(position);
+        auto last = document_->findBlock(position + charsAdded);
+        if (!last.isValid()) last = document_->lastBlock();
+
+        auto block_count = document_->blockCount();
+        auto first_number = first.blockNumber();
+        auto old_last_number =
+            last.blockNumber() - (block_count - blockCount_);
+        qsizetype old_size = old_last_number - first_number + 1;
+
+        blockCount_ = block_count;
+
+        if (charsAdded > ASYNC_MIN_CHARS_) {
+            recount_();
+            return;
+        }
+
+        if (!first.isValid() || old_size < 1) {
+            WARN("Block counts out of step with document! Recounting");
+            recount_();
+            return;
+        }
+
+        switch (state_) {
+        case State_::Ready:
+            if (old_last_number >= blockWords_.size()) {
+                WARN("Block counts out of step with document! Recounting");
+                recount_();
+                return;
+            }
+
+            splice_(first_number, old_size, countBlocks_(first, last));
+            emit countsChanged();
+            break;
+
+        case State_::Snapshotting:
+            patchSnapshot_(first, last, old_size);
+            break;
+
+        case State_::Counting:
+            splices_ << Splice_{ first_number,
+                                 old_size,
+                                 countBlocks_(first, last) };
+            break;
+        }
+    }
+
+};
+
+} // namespace Hearth
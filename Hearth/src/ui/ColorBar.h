@@ -100,6 +100,26 @@ public:
         startAnimation_(color, qBound(0, delay, 3000));
     }
 
+    // Shows determinate progress (0-100) for long operations, like a
+    // background save. Finish with run, which replaces it with the usual fill
+    void setProgress(Color color, int percent)
+    {
+        if (!active_) return;
+        if (!isVisible()) return;
+
+        if (activeTimeLine_) {
+            activeTimeLine_->stop();
+            activeTimeLine_->deleteLater();
+            activeTimeLine_ = nullptr;
+        }
+
+        linger_->stop();
+
+        currentColor_ = color;
+        currentProgress_ = qBound(MIN_RANGE_, qreal(percent), MAX_RANGE_);
+        update(); // Trigger repaint
+    }
+
     virtual bool eventFilter(QObject* watched, QEvent* event) override
     {
         if (watched == window_) {
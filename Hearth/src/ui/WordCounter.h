@@ -15,7 +15,6 @@
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QMargins>
-#include <QMouseEvent>
 #include <QPlainTextEdit>
 #include <QPointer>
 #include <QString>
@@ -28,17 +27,19 @@
 #include <Coco/Fx.h>
 
 #include "core/Debug.h"
-#include "core/Time.h"
 #include "core/Tr.h"
+#include "ui/BlockCounts.h"
 
 namespace Hearth {
 
 using namespace Qt::StringLiterals;
 
 // Status bar widget displaying document line, word, and char counts with cursor
-// position. Base counts are cached and updated on text changes (debounced, with
-// manual refresh fallback for large documents), while selection counts are
-// computed on demand from the cache without retriggering a full recount
+// position. Base counts come from the document's BlockCounts, which keeps them
+// live at O(edit) cost, so they update on every change at any document size
+// (dimmed while a full count runs off-thread). Selection counts are computed on
+// demand (the word count, from BlockCounts, shows its last known value, dimmed,
+// while BlockCounts isn't current)
 //
 // TODO: Padding of some kind to prevent bouncing around between labels /
 // separator / right edge of status bar (bouncing around inside labels
@@ -64,12 +65,10 @@ public:
 
         if (textEdit_) textEdit_->disconnect(this);
         textEdit_ = textEdit;
+        lastSelectionWords_ = 0;
+        attachCounts_();
 
         if (textEdit_) {
-            connect(textEdit_, &QPlainTextEdit::textChanged, this, [this] {
-                countDebouncer_->start();
-            });
-
             connect(
                 textEdit_,
                 &QPlainTextEdit::cursorPositionChanged,
@@ -82,13 +81,14 @@ public:
 
             connect(textEdit_, &QObject::destroyed, this, [this] {
                 textEdit_ = nullptr;
+                attachCounts_();
                 cachedBaseCounts_.clear();
                 updateCountsDisplay_();
                 updatePos_();
             });
         }
 
-        updateCounts_(Force_::Yes);
+        updateCounts_();
         updatePos_();
     }
 
@@ -99,11 +99,12 @@ public:
         if (active_ == active) return;
         active_ = active;
 
+        attachCounts_();
+
         if (active_) {
-            updateCounts_(Force_::Yes);
+            updateCounts_();
             updatePos_();
         } else {
-            countDebouncer_->stop();
             cachedBaseCounts_.clear();
             updateCountsDisplay_();
             updatePos_();
@@ -116,7 +117,7 @@ public:
     {
         if (hasLineCount_ == has) return;
         hasLineCount_ = has;
-        updateCounts_(Force_::Yes);
+        updateCounts_();
     }
 
     bool hasWordCount() const noexcept { return hasWordCount_; }
@@ -125,7 +126,7 @@ public:
     {
         if (hasWordCount_ == has) return;
         hasWordCount_ = has;
-        updateCounts_(Force_::Yes);
+        updateCounts_();
     }
 
     bool hasCharCount() const noexcept { return hasCharCount_; }
@@ -134,7 +135,7 @@ public:
     {
         if (hasCharCount_ == has) return;
         hasCharCount_ = has;
-        updateCounts_(Force_::Yes);
+        updateCounts_();
     }
 
     bool hasSelectionCounts() const noexcept { return hasSelectionCounts_; }
@@ -176,51 +177,23 @@ public:
         updatePos_();
     }
 
-protected:
-    virtual void mousePressEvent(QMouseEvent* event) override
-    {
-        // Maybe: && event->button() == Qt::LeftButton
-        if (!autoCount_) {
-            updateCounts_(Force_::Yes);
-            dimCountsDisplay_(false);
-            staleDimTimer_->start(); // Delay re-dimming
-
-            return;
-        }
-
-        QWidget::mousePressEvent(event);
-    }
-
 private:
     static constexpr auto MARGIN_ = 0.5;
     static constexpr auto DELIMITER_ = ", ";
     static constexpr auto SEPARATOR_ = " / ";
-
-    // Threshold at which we switch from auto-count to manual refresh. With
-    // in-place counting (no allocations), we can handle much larger documents
-    // in real time. ~500k chars is roughly a full novel
-    static constexpr qsizetype AUTO_COUNT_THRESHOLD_ = 500'000;
-    static constexpr int DEBOUNCE_MS_ = 150;
-    static constexpr int STALE_DIM_MS_ = 2000;
     static constexpr double FRESH_OPACITY_ = 0.8;
     static constexpr double STALE_OPACITY_ = 0.35;
 
     QPointer<QPlainTextEdit> textEdit_{};
-    Time::Debouncer* countDebouncer_ =
-        Time::newDebouncer(this, [this] { updateCounts_(); }, DEBOUNCE_MS_);
+    QPointer<BlockCounts> counts_{};
     QLabel* countsDisplay_ = new QLabel(this);
     QLabel* separatorDisplay_ = new QLabel(SEPARATOR_, this);
     QLabel* posDisplay_ = new QLabel(this);
-    Time::Delayer* staleDimTimer_ = Time::newDelayer(
-        this,
-        [this] { dimCountsDisplay_(true); },
-        STALE_DIM_MS_);
 
     COCO_BOOL(Force_)
 
     bool active_ = true;
 
-    bool autoCount_ = true;
     bool hasLineCount_ = true;
     bool hasWordCount_ = true;
     bool hasCharCount_ = false;
@@ -232,13 +205,17 @@ private:
     bool hasSelectionReplacement_ = true;
 
     // Cached base counts string, updated on text changes. Selection changes
-    // read from this cache rather than recomputing the (potentially expensive)
-    // full document counts
+    // read from this cache rather than rebuilding it
     QString cachedBaseCounts_{};
 
+    // Selection word count as of the last time BlockCounts was current, shown
+    // (dimmed) until it is again
+    int lastSelectionWords_ = 0;
+    bool selectionWordsStale_ = false;
+
     void setup_()
     {
-        Coco::Fx::opacify(countsDisplay_, 0.8);
+        Coco::Fx::opacify(countsDisplay_, FRESH_OPACITY_);
         Coco::Fx::opacify(separatorDisplay_, 0.3);
         Coco::Fx::opacify(posDisplay_, 0.8);
 
@@ -261,40 +238,49 @@ private:
 
     // --- Base count computation ---
 
-    void updateCounts_(Force_ force = Force_::No)
+    // Follows the text edit's document while active. Counts are created per
+    // document on first use and kept (see BlockCounts::of), so switching back
+    // to a document doesn't recount it
+    void attachCounts_()
+    {
+        auto counts = (active_ && textEdit_)
+                          ? BlockCounts::of(textEdit_->document())
+                          : nullptr;
+
+        if (counts_ == counts) return;
+        if (counts_) counts_->disconnect(this);
+        counts_ = counts;
+
+        if (counts_) {
+            connect(counts_, &BlockCounts::countsChanged, this, [this] {
+                updateCounts_();
+            });
+
+            connect(
+                counts_,
+                &BlockCounts::countingChanged,
+                this,
+                [this] { dimCountsDisplay_(isStale_()); });
+        }
+
+        dimCountsDisplay_(isStale_());
+    }
+
+    void updateCounts_()
     {
         if (!active_ || !textEdit_) {
             cachedBaseCounts_.clear();
-            adjustCountStyle_(0);
             updateCountsDisplay_();
 
             return;
         }
 
-        auto document = textEdit_->document();
-        auto char_count = document ? document->characterCount() : 0;
-        adjustCountStyle_(char_count);
-
-        if ((autoCount_ || force) && hasAnyCount_())
+        if (hasAnyCount_())
             cachedBaseCounts_ = buildCounts_(CountSource_::Document);
 
         updateCountsDisplay_();
     }
 
-    void adjustCountStyle_(qsizetype charCount)
-    {
-        if (charCount < AUTO_COUNT_THRESHOLD_) {
-            staleDimTimer_->stop();
-            dimCountsDisplay_(false);
-            setCursor(Qt::ArrowCursor);
-            autoCount_ = true;
-        } else if (autoCount_) {
-            setCursor(Qt::PointingHandCursor);
-            autoCount_ = false;
-            dimCountsDisplay_(true); // Dim immediately
-        }
-    }
-
     // --- Selection handling ---
 
     void updateSelection_()
@@ -302,15 +288,6 @@ private:
         // Selection changes never recompute base counts; they just rebuild the
         // display using the cache plus fresh (cheap) selection counts
         updateCountsDisplay_();
-
-        if (!autoCount_) {
-            if (hasSelectionCounts_ && hasActiveSelection_()) {
-                staleDimTimer_->stop();
-                dimCountsDisplay_(false);
-            } else {
-                dimCountsDisplay_(true);
-            }
-        }
     }
 
     bool hasActiveSelection_() const
@@ -328,48 +305,47 @@ private:
     };
 
     // Builds a counts string from either the full document or the current
-    // selection. Both paths use the same in-place counter, just on different
-    // text. The Document path uses blockCount() for lines (free), while the
-    // Selection path counts paragraph separators in the selected text
+    // selection. The Document path reads the running totals in BlockCounts.
+    // The Selection path never copies the selection: lines are the blocks it
+    // spans, chars its length, and words come from BlockCounts' prefix sums
+    // (the last known count while those aren't current). Drag selection,
+    // which rebuilds this on every mouse move, stays cheap at any size
     QString buildCounts_(CountSource_ source, Force_ force = Force_::No)
     {
         if (!textEdit_) return {};
 
         QStringList elements{};
-        QString text{};
         auto line = hasLineCount_ || force;
         auto word = hasWordCount_ || force;
         auto char_ = hasCharCount_ || force;
-        auto need_text = word || char_;
 
         if (source == CountSource_::Document) {
-            if (line) {
-                auto document = textEdit_->document();
-                auto lines = document ? document->blockCount() : 0;
-                elements << Tr::wordCounterLines(lines);
-            }
+            if (!counts_) return {};
 
-            if (need_text) text = textEdit_->toPlainText();
+            if (line) elements << Tr::wordCounterLines(counts_->lines());
+            if (word) elements << Tr::wordCounterWords(counts_->words());
+            if (char_) elements << Tr::wordCounterChars(counts_->chars());
 
         } else {
-            auto selected = textEdit_->textCursor().selectedText();
+            auto cursor = textEdit_->textCursor();
+            auto start = cursor.selectionStart();
+            auto end = cursor.selectionEnd();
 
             if (line) {
-                auto lines = selectionLineCount_(selected);
+                auto document = textEdit_->document();
+                auto lines = document->findBlock(end).blockNumber()
+                             - document->findBlock(start).blockNumber() + 1;
                 elements << Tr::wordCounterLines(lines);
             }
 
-            if (need_text) text = selected;
-        }
-
-        if (word) {
-            auto words = wordCount_(text);
-            elements << Tr::wordCounterWords(words);
-        }
+            if (word) {
+                auto words = counts_ ? counts_->wordsBetween(start, end) : -1;
+                selectionWordsStale_ = words < 0;
+                if (!selectionWordsStale_) lastSelectionWords_ = words;
+                elements << Tr::wordCounterWords(lastSelectionWords_);
+            }
 
-        if (char_) {
-            auto chars = text.size();
-            elements << Tr::wordCounterChars(chars);
+            if (char_) elements << Tr::wordCounterChars(end - start);
         }
 
         return elements.join(DELIMITER_);
@@ -393,6 +369,7 @@ private:
         }
 
         QString display{};
+        selectionWordsStale_ = false;
 
         if (any) {
             display = cachedBaseCounts_;
@@ -413,6 +390,7 @@ private:
 
         countsDisplay_->setText(display);
         setDisplayVisible_(countsDisplay_, true);
+        dimCountsDisplay_(isStale_());
     }
 
     // --- Position ---
@@ -454,38 +432,6 @@ private:
 
     bool hasAnyPos_() const noexcept { return hasLinePos_ || hasColPos_; }
 
-    // In-place word count: O(n) scan with zero allocations. Counts transitions
-    // from whitespace to non-whitespace
-    int wordCount_(const QString& text) const
-    {
-        auto count = 0;
-        auto in_word = false;
-
-        for (auto& ch : text) {
-            if (ch.isSpace() || ch == QChar::ParagraphSeparator) {
-                in_word = false;
-            } else if (!in_word) {
-                in_word = true;
-                ++count;
-            }
-        }
-
-        return count;
-    }
-
-    // QTextCursor::selectedText() uses U+2029 (ParagraphSeparator) instead of
-    // newlines. Each separator represents a block boundary, so line count is
-    // separators + 1
-    int selectionLineCount_(const QString& selectedText) const
-    {
-        auto separators = 0;
-
-        for (auto& ch : selectedText)
-            if (ch == QChar::ParagraphSeparator) ++separators;
-
-        return separators + 1;
-    }
-
     // --- Display helpers ---
 
     void setDisplayVisible_(QLabel* display, bool show)
@@ -497,12 +443,18 @@ private:
         if (!show) display->clear();
     }
 
+    // While a full count runs off-thread, the document counts shown are the
+    // last known ones (and so may be a selection's word count)
+    bool isStale_() const
+    {
+        return (counts_ && counts_->isCounting()) || selectionWordsStale_;
+    }
+
     void dimCountsDisplay_(bool dim)
     {
-        auto opacity = dim ? STALE_OPACITY_ : FRESH_OPACITY_;
-        Coco::Fx::opacify(countsDisplay_, opacity);
-        Coco::Fx::opacify(separatorDisplay_, dim ? STALE_OPACITY_ : 0.3);
-        Coco::Fx::opacify(posDisplay_, opacity);
+        Coco::Fx::opacify(
+            countsDisplay_,
+            dim ? STALE_OPACITY_ : FRESH_OPACITY_);
     }
 };
 
@@ -12,18 +12,30 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <utility>
 
+#include <QCoreApplication>
+#include <QFuture>
+#include <QFutureWatcher>
 #include <QHBoxLayout>
+#include <QHash>
+#include <QList>
+#include <QPromise>
 #include <QShowEvent>
 #include <QSplitter>
 #include <QString>
 #include <QStringList>
 #include <QStringView>
 #include <QTextDocument>
+#include <QThreadPool>
 #include <QVBoxLayout>
+#include <QVariantList>
 #include <QWidget>
+#include <QtConcurrent>
 
+#include "core/BlockDiff.h"
 #include "core/BundledFonts.h"
 #include "core/Time.h"
 #include "core/Tr.h"
@@ -31,6 +43,7 @@
 #include "ui/MultiSwitch.h"
 #include "ui/WidgetMask.h"
 #include "ui/WidgetSnapshotOverlay.h"
+#include "views/MarkupBridge.h"
 #include "views/MarkupWebcode.h"
 #include "views/TextFileView.h"
 #include "views/WebEnginePage.h"
@@ -38,6 +51,83 @@
 
 namespace Hearth {
 
+// Converts plain text to HTML for a markup preview (see
+// AbstractMarkupFileView::reparse_). Renderers run on the render worker, one
+// call at a time, and the worker shares ownership, so a renderer may keep
+// state between calls (caches) but must never reach into its view. Views of
+// the same file share one (see AbstractMarkupFileView::sharedRenderer_), and
+// blocks() remembers its last result, so split previews of a file parse each
+// change once
+class MarkupRenderer
+{
+public:
+    // One top-level HTML element per entry of html, each with a data-idx='N'
+    // attribute (N matching its list index), and a hash of each (see hash)
+    struct Blocks
+    {
+        QStringList html{};
+        QList<size_t> hashes{};
+    };
+
+    // Polled during a render, which may return early (and incomplete) once it
+    // says true
+    using Canceled = std::function<bool()>;
+
+    virtual ~MarkupRenderer() = default;
+
+    Blocks blocks(const QString& plainText, const Canceled& canceled = {})
+    {
+        if (hasLast_ && plainText == lastText_) return lastBlocks_;
+
+        static const Canceled never = [] { return false; };
+        auto blocks = render(plainText, canceled ? canceled : never);
+
+        // A canceled render may be partial, so it isn't kept
+        if (canceled && canceled()) return blocks;
+
+        lastBlocks_ = blocks;
+        lastText_ = plainText;
+        hasLast_ = true;
+
+        return blocks;
+    }
+
+    // A block's content hash, not counting its data-idx attribute (which
+    // changes with its position), so blocks can be matched across renders by
+    // comparing hashes. 64 bits on 64-bit builds, where a collision between
+    // different blocks isn't a practical concern
+    static size_t hash(QStringView html)
+    {
+        static constexpr QStringView attribute = u" data-idx='";
+
+        auto at = html.indexOf(attribute);
+        if (at < 0) return hash(html, {});
+
+        auto end = html.indexOf(QChar('\''), at + attribute.size());
+        return hash(
+            html.first(at),
+            end < 0 ? QStringView{} : html.sliced(end + 1));
+    }
+
+    // The same, for a block with the HTML before and after its data-idx
+    // attribute held separately
+    static size_t hash(QStringView head, QStringView tail)
+    {
+        return qHash(tail, qHash(head));
+    }
+
+protected:
+    // Long renders should poll canceled between steps and return (with
+    // anything) when it's true
+    virtual Blocks
+    render(const QString& plainText, const Canceled& canceled) = 0;
+
+private:
+    bool hasLast_ = false;
+    QString lastText_{};
+    Blocks lastBlocks_{};
+};
+
 /// TODO MU: Scroll lock
 /// TODO MU: Preview auto-scroll for new content added (like a soft scroll lock
 /// while typing at the end of the page)
@@ -82,8 +172,11 @@ protected:
     {
         auto editor_widget = TextFileView::setupWidget();
         editor_widget->setMinimumWidth(MIN_WIDGET_SIZE_);
+        renderer_ = sharedRenderer_();
 
-        preview_->setPage(new WebEnginePage(preview_));
+        auto page = new WebEnginePage(preview_);
+        preview_->setPage(page);
+        bridge_ = new MarkupBridge(page);
         preview_->setMinimumWidth(MIN_WIDGET_SIZE_);
 
         splitter_->addWidget(editor_widget);
@@ -136,6 +229,18 @@ protected:
             this,
             [this](int index) { applyMode_(static_cast<Mode>(index)); });
 
+        connect(
+            renderWatcher_,
+            &QFutureWatcher<Render_>::finished,
+            this,
+            &AbstractMarkupFileView::onRenderWatcherFinished_);
+
+        connect(
+            bridge_,
+            &MarkupBridge::resyncRequested,
+            this,
+            &AbstractMarkupFileView::onBridgeResyncRequested_);
+
         // Can't call setMode to start (see setMode note)
         splitter_->setFocusProxy(editor_widget);
         reparse_();
@@ -164,10 +269,11 @@ protected:
     }
 
     // Subclasses implement these to convert plain text to HTML for the preview
-    // (see `reparse_` note):
+    // (see `reparse_` note). A renderer is made when the first view of a file
+    // is set up and shared with the file's other views (see sharedRenderer_):
 
     virtual QStringView css() const = 0;
-    virtual QStringList htmlBlocks(const QString& plainText) const = 0;
+    virtual std::shared_ptr<MarkupRenderer> newRenderer() const = 0;
 
     /// TODO MU: Consider restructuring Fountain CSS and removing. These are
     /// kind of just suppoting a holdover (article/section tags) from original's
@@ -189,9 +295,32 @@ private:
     Time::Debouncer* reparseTimer_;
 
     constexpr static int MIN_WIDGET_SIZE_ = 50;
+
+    // Past this many block insertions and removals (after the common start
+    // and end), a preview update replaces the page body instead of patching
+    constexpr static qsizetype MAX_PATCH_EDITS_ = 256;
     bool firstParse_ = true;
     bool previewStale_ = false;
-    QStringList cachedBlocks_{};
+    QList<size_t> shownHashes_{}; // See MarkupRenderer::hash
+
+    // What the render worker hands back. A first render is a whole page
+    // (html); after that, operations patching the page (empty if nothing
+    // changed)
+    struct Render_
+    {
+        quint64 generation = 0;
+        QList<size_t> hashes{};
+        QString html{};
+        QVariantList ops{};
+    };
+
+    std::shared_ptr<MarkupRenderer> renderer_{};
+    MarkupBridge* bridge_ = nullptr;
+    QFutureWatcher<Render_>* renderWatcher_ =
+        new QFutureWatcher<Render_>(this);
+    quint64 generation_ = 0;
+    bool rendering_ = false;
+    bool renderPending_ = false;
 
     Mode mode_ = Split;
     QWidget* container_ = new QWidget(this);
@@ -251,68 +380,236 @@ private:
 
     // Incremental DOM patching
     //
-    // Subclasses return a QStringList from htmlBlocks() where each entry is one
-    // top-level HTML element with a data-idx='N' attribute (N matching its list
-    // index). On subsequent reparses, we diff the new list against the cached
-    // one and patch only changed blocks via JS outerHTML assignment. When the
-    // block count changes (insertions/deletions), we fall back to full
-    // innerHTML replacement
+    // Renderers return a list where each entry is one top-level HTML element
+    // with a data-idx='N' attribute (N matching its list index), plus its
+    // hash. On subsequent reparses, we diff the new hashes against the shown
+    // ones and patch only the changed blocks, inserting, removing, and
+    // renumbering blocks as needed (see patchOps_), so adding or deleting a
+    // paragraph costs about as much as editing one
     //
     // Subclasses that wrap their output in container elements (article,
     // section, etc.) should return those via bodyPrefix()/bodySuffix() rather
     // than including them in the block list, since they are not indexed and are
     // only used for first parse and full replacement
+    //
+    // Parsing, diffing, and building the patch all run on the render worker
+    // (see renderPool_), one render per view at a time. Each reparse takes a
+    // new generation number. A reparse while a render runs cancels it and
+    // waits to start after it. The renderer polls for cancellation (Markdown
+    // between segments; Fountain, one parser call, can't stop until it's
+    // done), and the worker checks again before diffing. A result that isn't
+    // the latest generation is dropped, so only the newest text is ever
+    // shown. Only taking the text and handing the result to the page happen
+    // on the GUI thread
     /// TODO MU: Print total output for this to check md/fn
     void reparse_()
     {
-        auto editor = this->editor();
-        if (!preview_ || !editor) return;
+        if (!preview_ || !editor() || !renderer_) return;
 
-        auto blocks = htmlBlocks(editor->document()->toPlainText());
+        ++generation_;
 
-        if (firstParse_) {
-            firstParse_ = false;
+        if (rendering_) {
+            renderPending_ = true;
+            renderWatcher_->cancel();
+            return;
+        }
 
-            auto body = bodyPrefix() + blocks.join(QString{}) + bodySuffix();
-            auto html =
-                MarkupWebcode::htmlDoc(BundledFonts::cssAtRules(), css(), body);
+        startRender_();
+    }
 
-            /// TODO MU: I am vaguely concerned about the baseUrl
-            preview_->setHtml(html, QUrl("qrc:/"));
-            cachedBlocks_ = std::move(blocks);
-            return;
+    // Views of the same file and kind share a renderer. The registry only
+    // holds weak references, so a renderer goes when its views (and any
+    // render still using it) do
+    std::shared_ptr<MarkupRenderer> sharedRenderer_()
+    {
+        using Key = std::pair<const TextFileModel*, const QMetaObject*>;
+        static QHash<Key, std::weak_ptr<MarkupRenderer>> renderers{};
+
+        for (auto it = renderers.begin(); it != renderers.end();)
+            it = it->expired() ? renderers.erase(it) : ++it;
+
+        auto& entry = renderers[{ qobject_cast<TextFileModel*>(model()),
+                                  metaObject() }];
+        auto renderer = entry.lock();
+
+        if (!renderer) {
+            renderer = newRenderer();
+            entry = renderer;
         }
 
-        // Try incremental patch when block count is unchanged
-        if (blocks.size() == cachedBlocks_.size()) {
-            QString js_patch{};
+        return renderer;
+    }
+
+    // A single thread for all markup views, so renders never compete with
+    // each other (or the global pool) for cores
+    static QThreadPool* renderPool_()
+    {
+        static auto pool = [] {
+            auto pool = new QThreadPool(QCoreApplication::instance());
+            pool->setMaxThreadCount(1);
+            return pool;
+        }();
+
+        return pool;
+    }
+
+    void startRender_()
+    {
+        rendering_ = true;
+        renderPending_ = false;
+
+        // Everything the worker needs from the view is copied here
+        auto first = firstParse_;
+        QString font_face_kit{};
+        QString page_css{};
+
+        if (first) {
+            font_face_kit = BundledFonts::cssAtRules();
+            page_css = css().toString();
+        }
 
-            for (auto i = 0; i < blocks.size(); ++i) {
-                if (blocks[i] == cachedBlocks_[i]) continue;
+        auto task = [renderer = renderer_,
+                     generation = generation_,
+                     text = editor()->document()->toPlainText(),
+                     shown = shownHashes_,
+                     first,
+                     font_face_kit,
+                     page_css,
+                     prefix = bodyPrefix(),
+                     suffix = bodySuffix()](QPromise<Render_>& promise) {
+            Render_ render{};
+            render.generation = generation;
+            auto blocks = renderer->blocks(text, [&promise] {
+                return promise.isCanceled();
+            });
+            render.hashes = blocks.hashes;
 
-                QString escaped = blocks[i];
-                escaped.replace(u"\\"_s, u"\\\\"_s);
-                escaped.replace(u"`"_s, u"\\`"_s);
+            if (promise.isCanceled()) return;
 
-                js_patch += MarkupWebcode::jsOuterHtml(i, escaped);
+            if (first) {
+                auto body = prefix + blocks.html.join(QString{}) + suffix;
+                render.html =
+                    MarkupWebcode::htmlDoc(font_face_kit, page_css, body);
+            } else {
+                render.ops = patchOps_(shown, blocks, prefix, suffix);
             }
 
-            if (!js_patch.isEmpty()) {
-                preview_->page()->runJavaScript(
-                    MarkupWebcode::jsPatchHtmlBody(js_patch));
+            promise.addResult(render);
+        };
+
+        renderWatcher_->setFuture(QtConcurrent::run(renderPool_(), task));
+    }
+
+    // Empty if nothing changed. Blocks are matched by hash, which ignores
+    // their data-idx (an insertion renumbers everything after it), so a
+    // comparison is O(1) and the view only keeps the hashes of what it shows.
+    // Each run of changed blocks becomes an insertion of the new ones before
+    // (or after) an unchanged neighbor plus a removal of the old ones.
+    // Unchanged blocks that moved are just renumbered. Only a page with no
+    // blocks yet, or too many scattered changes, gets its body replaced whole
+    static QVariantList patchOps_(
+        const QList<size_t>& shown,
+        const MarkupRenderer::Blocks& blocks,
+        const QString& prefix,
+        const QString& suffix)
+    {
+        if (!shown.isEmpty()) {
+            auto hunks = BlockDiff::hunks(
+                shown.size(),
+                blocks.hashes.size(),
+                [&](qsizetype i, qsizetype j) {
+                    return shown[i] == blocks.hashes[j];
+                },
+                MAX_PATCH_EDITS_);
+
+            if (hunks) return hunkOps_(*hunks, shown.size(), blocks.html);
+        }
+
+        auto body = prefix + blocks.html.join(QString()) + suffix;
+        return { MarkupBridge::bodyOp(body) };
+    }
+
+    static QVariantList hunkOps_(
+        const QList<BlockDiff::Hunk>& hunks,
+        qsizetype shownSize,
+        const QStringList& blocks)
+    {
+        QVariantList ops{};
+        qsizetype kept = 0; // Start of the unchanged run before a hunk
+
+        // Unchanged blocks [first, end) are now shift places later
+        auto reindex = [&](qsizetype first, qsizetype end, qsizetype shift) {
+            if (end > first && shift != 0)
+                ops << MarkupBridge::reindexOp(
+                    int(first),
+                    int(end - first),
+                    int(shift));
+        };
+
+        for (auto& hunk : hunks) {
+            reindex(kept, hunk.oldStart, hunk.newStart - hunk.oldStart);
+
+            if (hunk.newCount > 0) {
+                auto after = hunk.oldStart == shownSize;
+
+                ops << MarkupBridge::insertOp(
+                    int(after ? shownSize - 1 : hunk.oldStart),
+                    after,
+                    blocks.sliced(hunk.newStart, hunk.newCount)
+                        .join(QString{}));
             }
 
-            cachedBlocks_ = std::move(blocks);
-            return;
+            if (hunk.oldCount > 0)
+                ops << MarkupBridge::removeOp(
+                    int(hunk.oldStart),
+                    int(hunk.oldCount));
+
+            kept = hunk.oldStart + hunk.oldCount;
+        }
+
+        reindex(kept, shownSize, blocks.size() - shownSize);
+
+        return ops;
+    }
+
+private slots:
+    void onRenderWatcherFinished_()
+    {
+        rendering_ = false;
+        auto future = renderWatcher_->future();
+
+        if (!future.isCanceled() && future.resultCount() > 0) {
+            auto render = future.result();
+
+            if (render.generation == generation_) apply_(render);
         }
 
-        // Full fallback replacement (block count changed)
-        auto body = bodyPrefix() + blocks.join(QString()) + bodySuffix();
-        body.replace(u"\\"_s, u"\\\\"_s);
-        body.replace(u"`"_s, u"\\`"_s);
+        if (renderPending_) startRender_();
+    }
+
+    // The page no longer matches shownHashes_, so forget them: the next
+    // render (started now, superseding any in flight) replaces the body whole
+    void onBridgeResyncRequested_()
+    {
+        shownHashes_.clear();
+        reparse_();
+    }
+
+private:
+    void apply_(Render_& render)
+    {
+        if (firstParse_) {
+            firstParse_ = false;
+
+            /// TODO MU: I am vaguely concerned about the baseUrl
+            bridge_->reset();
+            preview_->setHtml(render.html, QUrl("qrc:/"));
+
+        } else {
+            bridge_->send(render.ops);
+        }
 
-        preview_->page()->runJavaScript(MarkupWebcode::jsReplaceHtmlBody(body));
-        cachedBlocks_ = std::move(blocks);
+        shownHashes_ = std::move(render.hashes);
     }
 };
 
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include <QChar>
@@ -33,6 +34,40 @@ namespace Hearth {
 
 using namespace Qt::StringLiterals;
 
+// fountain-html rendering for FountainFileView
+class FountainRenderer : public MarkupRenderer
+{
+protected:
+    // One fn_html call, which can't stop partway
+    virtual Blocks render(
+        const QString& plainText,
+        [[maybe_unused]] const Canceled& canceled) override
+    {
+        auto input = plainText.toUtf8();
+        QByteArray output{};
+        output.reserve(input.size() * 2);
+
+        fn_html(
+            input.constData(),
+            FN_SIZE(input.size()),
+            [](const FN_CHAR* chunk, FN_SIZE size, void* userdata) {
+                static_cast<QByteArray*>(userdata)->append(chunk, size);
+            },
+            &output,
+            0,
+            FN_HTML_FLAG_BLOCK_INDEX);
+
+        Blocks blocks{};
+        blocks.html = QString::fromUtf8(output).split(QChar('\x01'));
+        blocks.hashes.reserve(blocks.html.size());
+
+        for (auto& block : blocks.html)
+            blocks.hashes << hash(block);
+
+        return blocks;
+    }
+};
+
 /// TODO MU: Printing layout
 /// TODO MU: Can use special style to space out the title page to approximate
 /// print layout and leave the rest in flow HTML
@@ -187,24 +222,9 @@ hr {
         return s;
     }
 
-    virtual QStringList htmlBlocks(const QString& plainText) const override
+    virtual std::shared_ptr<MarkupRenderer> newRenderer() const override
     {
-        auto input = plainText.toUtf8();
-        QByteArray output{};
-        output.reserve(input.size() * 2);
-
-        fn_html(
-            input.constData(),
-            FN_SIZE(input.size()),
-            [](const FN_CHAR* chunk, FN_SIZE size, void* userdata) {
-                static_cast<QByteArray*>(userdata)->append(chunk, size);
-            },
-            &output,
-            0,
-            FN_HTML_FLAG_BLOCK_INDEX);
-
-        auto str = QString::fromUtf8(output);
-        return str.split(QChar('\x01'));
+        return std::make_shared<FountainRenderer>();
     }
 
     virtual QString bodyPrefix() const override
@@ -12,8 +12,12 @@
 
 #pragma once
 
+#include <memory>
+#include <utility>
+
 #include <QByteArray>
 #include <QChar>
+#include <QHash>
 #include <QList>
 #include <QString>
 #include <QStringList>
@@ -29,6 +33,533 @@ namespace Hearth {
 
 using namespace Qt::StringLiterals;
 
+// md4c rendering for MarkdownFileView
+class MarkdownRenderer : public MarkupRenderer
+{
+protected:
+    // Parses only what changed. The text is cut into segments at blank lines
+    // where Markdown guarantees nothing carries over (see segments_), and each
+    // segment's HTML blocks are cached by its source. Typing re-renders the
+    // one segment around the edit; everything else is reused, then indexed in
+    // order. Cutting and hashing are plain scans, so a keystroke costs a parse
+    // of a few paragraphs however long the document is. Block hashes are
+    // cached with their HTML, so they aren't recomputed either. A canceled
+    // render stops between segments, keeping the ones it rendered so far
+    virtual Blocks
+    render(const QString& plainText, const Canceled& canceled) override
+    {
+        QHash<size_t, Segment_> cache{};
+        Blocks blocks{};
+        auto index = 0;
+        auto segments = segments_(plainText);
+
+        for (qsizetype i = 0; i < segments.size(); ++i) {
+            if (canceled()) {
+                segmentCache_.insert(cache);
+                return {};
+            }
+
+            auto source = segments[i];
+            auto segment = segment_(source, cache);
+
+            // An HTML element the segmenter missed was left open (or closed)
+            // across a cut, so parse on through the next segment, as a full
+            // parse would. If that doesn't balance it, parse the rest whole
+            // rather than regrow the source a segment at a time
+            for (auto merges = 0; !segment.balanced && i + 1 < segments.size();
+                 ++merges) {
+                i = merges == 0 ? i + 1 : segments.size() - 1;
+                auto& last = segments[i];
+                source = QStringView(
+                    source.data(),
+                    last.data() + last.size() - source.data());
+                segment = segment_(source, cache);
+            }
+
+            for (auto& block : segment.blocks) {
+                blocks.html << indexed_(block, index++);
+                blocks.hashes << block.hash;
+            }
+        }
+
+        // Keeps only what this parse used
+        segmentCache_ = std::move(cache);
+        return blocks;
+    }
+
+private:
+    // A top-level HTML element, where to put its data-idx attribute (right
+    // after the tag name), and its hash (see MarkupRenderer::hash)
+    struct Block_
+    {
+        QString html{};
+        qsizetype injectAt = 0;
+        size_t hash = 0;
+    };
+
+    // Balanced if every element the segment's HTML opens, it also closes
+    struct Segment_
+    {
+        QString source{};
+        QList<Block_> blocks{};
+        bool balanced = true;
+    };
+
+    QHash<size_t, Segment_> segmentCache_{};
+
+    // Cached or freshly rendered, and kept in cache (what this parse used)
+    Segment_ segment_(QStringView source, QHash<size_t, Segment_>& cache)
+    {
+        auto key = qHash(source);
+        auto it = segmentCache_.constFind(key);
+
+        auto segment = (it != segmentCache_.cend() && it->source == source)
+                           ? *it
+                           : render_(source);
+
+        cache.insert(key, segment);
+        return segment;
+    }
+
+    static Segment_ render_(QStringView source)
+    {
+        auto input = source.toUtf8();
+        QByteArray output{};
+        output.reserve(input.size() * 2);
+
+        md_html(
+            input.constData(),
+            MD_SIZE(input.size()),
+            [](const MD_CHAR* chunk, MD_SIZE size, void* userdata) {
+                static_cast<QByteArray*>(userdata)->append(chunk, size);
+            },
+            &output,
+            MD_FLAG_TABLES | MD_FLAG_STRIKETHROUGH | MD_FLAG_TASKLISTS,
+            0);
+
+        Segment_ segment{};
+        segment.source = source.toString();
+        segment.blocks =
+            splitMdHtml_(QString::fromUtf8(output), segment.balanced);
+
+        return segment;
+    }
+
+    static QString indexed_(const Block_& block, int index)
+    {
+        QString html{};
+        html.reserve(block.html.size() + 20);
+        html.append(QStringView(block.html).first(block.injectAt));
+        html.append(u" data-idx='%1'"_s.arg(index));
+        html.append(QStringView(block.html).sliced(block.injectAt));
+
+        return html;
+    }
+
+    // --- Segmenting ---
+
+    // Cuts text into segments that parse the same alone as they do in place.
+    // A cut goes after a run of blank lines, and only where nothing open can
+    // continue past it:
+    //
+    // - Not inside a fenced code block or an HTML block that doesn't end at a
+    //   blank line (<pre>, <script>, comments, and the like)
+    // - Not before a list marker or an indented line if the segment has a
+    //   list (the list would continue, possibly loose)
+    // - Not between two indented code lines (one code block)
+    // - Not inside a raw HTML element opened by a line of HTML (e.g., <div> or
+    //   <details> wrapping Markdown in blank lines), which would be cut from
+    //   its closing tag
+    //
+    // Cuts are conservative: a missed cut only means a bigger segment (and
+    // render merges a segment whose HTML is still unbalanced with the next).
+    // A link reference definition can be used anywhere, so a document with
+    // one is a single segment (a full parse)
+    static QList<QStringView> segments_(QStringView text)
+    {
+        QList<QStringView> segments{};
+        qsizetype segment_start = 0;
+        qsizetype cut = -1; // After the last blank line, if it could be a cut
+
+        QChar fence{};
+        qsizetype fence_length = 0;
+        QStringView html_end{};
+        QList<QStringView> html_open{};
+
+        auto has_list = false;
+        auto last_indented = false;
+
+        qsizetype line_start = 0;
+
+        while (line_start < text.size()) {
+            auto line_end = text.indexOf(QChar('\n'), line_start);
+            auto next = line_end < 0 ? text.size() : line_end + 1;
+            if (line_end < 0) line_end = text.size();
+
+            auto line = text.sliced(line_start, line_end - line_start);
+            auto indent = indent_(line);
+            auto content = line.trimmed();
+
+            if (!fence.isNull()) {
+                if (indent < 4 && closesFence_(content, fence, fence_length))
+                    fence = QChar{};
+
+            } else if (!html_end.isEmpty()) {
+                if (line.contains(html_end, Qt::CaseInsensitive))
+                    html_end = {};
+
+            } else if (content.isEmpty()) {
+                cut = next;
+
+            } else {
+                if (indent < 4 && isLinkDefinition_(content)) return { text };
+
+                if (cut > segment_start && html_open.isEmpty()) {
+                    auto continues = ((isListItem_(content) || indent > 0)
+                                      && has_list)
+                                     || (indent >= 4 && last_indented);
+
+                    if (!continues) {
+                        segments << text.sliced(
+                            segment_start,
+                            cut - segment_start);
+                        segment_start = cut;
+                        has_list = false;
+                    }
+                }
+
+                cut = -1;
+
+                if (indent < 4) {
+                    if (isListItem_(content)) has_list = true;
+                    opensFence_(content, fence, fence_length);
+                    if (fence.isNull()) html_end = htmlBlockEnd_(content);
+
+                    if (fence.isNull() && html_end.isEmpty()
+                        && content.startsWith(QChar('<')))
+                        trackHtmlTags_(content, html_open);
+                }
+
+                last_indented = indent >= 4;
+            }
+
+            line_start = next;
+        }
+
+        if (segment_start < text.size())
+            segments << text.sliced(segment_start);
+
+        return segments;
+    }
+
+    // Columns of leading whitespace (a tab counts as 4, which is all that
+    // matters here)
+    static qsizetype indent_(QStringView line)
+    {
+        qsizetype columns = 0;
+
+        for (auto ch : line) {
+            if (ch == QChar(' '))
+                ++columns;
+            else if (ch == QChar('\t'))
+                columns += 4;
+            else
+                break;
+        }
+
+        return columns;
+    }
+
+    // "- ", "+ ", "* ", "1. ", "1) " (or the marker alone on its line)
+    static bool isListItem_(QStringView content)
+    {
+        if (content.isEmpty()) return false;
+
+        qsizetype i = 0;
+        auto first = content[0];
+
+        if (first == QChar('-') || first == QChar('+') || first == QChar('*')) {
+            i = 1;
+        } else {
+            while (i < content.size() && i < 9 && content[i].isDigit())
+                ++i;
+
+            if (i == 0 || i >= content.size()) return false;
+            if (content[i] != QChar('.') && content[i] != QChar(')'))
+                return false;
+
+            ++i;
+        }
+
+        return i >= content.size() || content[i] == QChar(' ')
+               || content[i] == QChar('\t');
+    }
+
+    // "[label]: ..." (also inside block quotes)
+    static bool isLinkDefinition_(QStringView content)
+    {
+        while (!content.isEmpty()
+               && (content[0] == QChar('>') || content[0].isSpace()))
+            content = content.sliced(1);
+
+        if (!content.startsWith(QChar('['))) return false;
+
+        auto close = content.indexOf(u"]:");
+        return close > 1;
+    }
+
+    static void
+    opensFence_(QStringView content, QChar& fence, qsizetype& fenceLength)
+    {
+        if (content.isEmpty()) return;
+
+        auto ch = content[0];
+        if (ch != QChar('`') && ch != QChar('~')) return;
+
+        qsizetype length = 0;
+        while (length < content.size() && content[length] == ch)
+            ++length;
+
+        if (length < 3) return;
+
+        // A backtick fence's info string can't contain backticks
+        if (ch == QChar('`') && content.sliced(length).contains(ch)) return;
+
+        fence = ch;
+        fenceLength = length;
+    }
+
+    static bool
+    closesFence_(QStringView content, QChar fence, qsizetype fenceLength)
+    {
+        qsizetype length = 0;
+        while (length < content.size() && content[length] == fence)
+            ++length;
+
+        return length >= fenceLength
+               && content.sliced(length).trimmed().isEmpty();
+    }
+
+    // For HTML blocks that run until a marker rather than a blank line,
+    // returns the marker (empty if content doesn't start one or ends it on the
+    // same line)
+    static QStringView htmlBlockEnd_(QStringView content)
+    {
+        static const QList<std::pair<QString, QString>> markers{
+            { u"<script"_s, u"</script>"_s },
+            { u"<pre"_s, u"</pre>"_s },
+            { u"<style"_s, u"</style>"_s },
+            { u"<textarea"_s, u"</textarea>"_s },
+            { u"<!--"_s, u"-->"_s },
+            { u"<![CDATA["_s, u"]]>"_s },
+            { u"<?"_s, u"?>"_s },
+            { u"<!"_s, u">"_s }
+        };
+
+        for (auto& [start, end] : markers) {
+            if (!content.startsWith(start, Qt::CaseInsensitive)) continue;
+
+            auto after = content.sliced(start.size());
+
+            // Tag names must end there, and "<!" must be followed by a letter
+            if (start[1].isLetter() && !after.isEmpty()
+                && after[0] != QChar('>') && !after[0].isSpace())
+                continue;
+            if (start == u"<!" && (after.isEmpty() || !after[0].isLetter()))
+                continue;
+
+            // Ends on its own first line
+            if (after.contains(end, Qt::CaseInsensitive)) return {};
+
+            return end;
+        }
+
+        return {};
+    }
+
+    // Pushes the elements a line of HTML opens onto open and pops those it
+    // closes. A close tag pops any unclosed elements inside it too (e.g., a
+    // <summary> left open in <details>), and one with nothing to match is
+    // ignored
+    static void trackHtmlTags_(QStringView content, QList<QStringView>& open)
+    {
+        auto i = content.indexOf(QChar('<'));
+
+        while (i >= 0 && i + 1 < content.size()) {
+            auto closing = content[i + 1] == QChar('/');
+            auto name_start = closing ? i + 2 : i + 1;
+            auto name_end = name_start;
+
+            while (name_end < content.size()
+                   && (content[name_end].isLetterOrNumber()
+                       || content[name_end] == QChar('-')))
+                ++name_end;
+
+            auto tag_end = content.indexOf(QChar('>'), name_end);
+            if (tag_end < 0) break;
+
+            if (name_end > name_start && content[name_start].isLetter()) {
+                auto name = content.sliced(name_start, name_end - name_start);
+
+                if (closing) {
+                    for (auto j = open.size() - 1; j >= 0; --j) {
+                        if (open[j].compare(name, Qt::CaseInsensitive) != 0)
+                            continue;
+
+                        open.resize(j);
+                        break;
+                    }
+
+                } else if (content[tag_end - 1] != QChar('/')
+                           && !isVoidTag_(name)) {
+                    open << name;
+                }
+            }
+
+            i = content.indexOf(QChar('<'), tag_end + 1);
+        }
+    }
+
+    // Elements with no closing tag
+    static bool isVoidTag_(QStringView name)
+    {
+        static const QStringList voids{
+            u"area"_s,  u"base"_s, u"br"_s,    u"col"_s,
+            u"embed"_s, u"hr"_s,   u"img"_s,   u"input"_s,
+            u"link"_s,  u"meta"_s, u"param"_s, u"source"_s,
+            u"track"_s, u"wbr"_s
+        };
+
+        return voids.contains(name, Qt::CaseInsensitive);
+    }
+
+    // --- Splitting ---
+
+    // Elements left unclosed are dropped, and balanced is set false if any
+    // were (or if a closing tag had no opening one)
+    static QList<Block_> splitMdHtml_(const QString& html, bool& balanced)
+    {
+        struct Block
+        {
+            qsizetype start; // index of '<' that opens this block
+            qsizetype injectAt; // index right after tag name
+            qsizetype end; // past-the-end index of this block
+        };
+
+        QList<Block> found_blocks{};
+        const qsizetype len = html.size();
+        QList<QStringView> open{};
+        qsizetype i = 0;
+
+        while (i < len) {
+            if (html[i] != QLatin1Char('<')) {
+                i++;
+                continue;
+            }
+
+            auto closing = (i + 1 < len && html[i + 1] == QLatin1Char('/'));
+            auto name_start = closing ? i + 2 : i + 1;
+            auto name_end = name_start;
+
+            while (name_end < len) {
+                auto c = html[name_end];
+                if (c == QLatin1Char(' ') || c == QLatin1Char('>')
+                    || c == QLatin1Char('/') || c == QLatin1Char('\n'))
+                    break;
+
+                name_end++;
+            }
+
+            auto tag_end = name_end;
+
+            while (tag_end < len && html[tag_end] != QLatin1Char('>')) {
+                tag_end++;
+            }
+
+            if (tag_end >= len) break;
+
+            auto name =
+                QStringView(html).mid(name_start, name_end - name_start);
+
+            // Comments, declarations, and the like (which no close tag ends)
+            if (name.isEmpty() || !name[0].isLetter()) {
+                i = tag_end + 1;
+                continue;
+            }
+
+            auto is_void =
+                isVoidTag_(name) || html[tag_end - 1] == QLatin1Char('/');
+
+            if (closing) {
+                i = tag_end + 1;
+
+                // Closes any unclosed elements inside it too
+                auto match = open.size() - 1;
+                while (match >= 0
+                       && open[match].compare(name, Qt::CaseInsensitive) != 0)
+                    --match;
+
+                if (match < 0) {
+                    balanced = false;
+                    continue;
+                }
+
+                open.resize(match);
+
+                if (open.isEmpty() && !found_blocks.isEmpty()) {
+                    auto end = i;
+
+                    while (end < len && html[end] == QLatin1Char('\n')) {
+                        end++;
+                    }
+
+                    found_blocks.last().end = end;
+                }
+
+            } else if (is_void) {
+                if (open.isEmpty()) {
+                    auto end = tag_end + 1;
+
+                    while (end < len && html[end] == QLatin1Char('\n')) {
+                        end++;
+                    }
+
+                    found_blocks.append({ i, name_end, end });
+                }
+
+                i = tag_end + 1;
+
+            } else {
+                if (open.isEmpty()) found_blocks.append({ i, name_end, -1 });
+                open << name;
+                i = tag_end + 1;
+            }
+        }
+
+        if (!open.isEmpty()) balanced = false;
+
+        QList<Block_> blocks{};
+        blocks.reserve(found_blocks.size());
+
+        for (const auto& found_block : found_blocks) {
+            if (found_block.end < 0) continue;
+
+            auto block_html = html.mid(
+                found_block.start,
+                found_block.end - found_block.start);
+            auto inject_at = found_block.injectAt - found_block.start;
+            QStringView view(block_html);
+
+            blocks.append(
+                { block_html,
+                  inject_at,
+                  hash(view.first(inject_at), view.sliced(inject_at)) });
+        }
+
+        return blocks;
+    }
+};
+
 class MarkdownFileView : public AbstractMarkupFileView
 {
     Q_OBJECT
@@ -141,134 +672,9 @@ blockquote, pre, table, ul, ol, hr {
         return s;
     }
 
-    virtual QStringList htmlBlocks(const QString& plainText) const override
-    {
-        auto input = plainText.toUtf8();
-        QByteArray output{};
-        output.reserve(input.size() * 2);
-
-        md_html(
-            input.constData(),
-            MD_SIZE(input.size()),
-            [](const MD_CHAR* chunk, MD_SIZE size, void* userdata) {
-                static_cast<QByteArray*>(userdata)->append(chunk, size);
-            },
-            &output,
-            MD_FLAG_TABLES | MD_FLAG_STRIKETHROUGH | MD_FLAG_TASKLISTS,
-            0);
-
-        return splitMdHtml_(QString::fromUtf8(output));
-    }
-
-private:
-    static QStringList splitMdHtml_(const QString& html)
+    virtual std::shared_ptr<MarkupRenderer> newRenderer() const override
     {
-        struct Block
-        {
-            qsizetype start; // index of '<' that opens this block
-            qsizetype injectAt; // index right after tag name
-            qsizetype end; // past-the-end index of this block
-        };
-
-        QList<Block> found_blocks{};
-        const qsizetype len = html.size();
-        auto depth = 0;
-        qsizetype i = 0;
-
-        while (i < len) {
-            if (html[i] != QLatin1Char('<')) {
-                i++;
-                continue;
-            }
-
-            auto closing = (i + 1 < len && html[i + 1] == QLatin1Char('/'));
-            auto name_start = closing ? i + 2 : i + 1;
-            auto name_end = name_start;
-
-            while (name_end < len) {
-                auto c = html[name_end];
-                if (c == QLatin1Char(' ') || c == QLatin1Char('>')
-                    || c == QLatin1Char('/') || c == QLatin1Char('\n'))
-                    break;
-
-                name_end++;
-            }
-
-            auto tag_end = name_end;
-
-            while (tag_end < len && html[tag_end] != QLatin1Char('>')) {
-                tag_end++;
-            }
-
-            if (tag_end >= len) break;
-
-            auto name =
-                QStringView(html).mid(name_start, name_end - name_start);
-
-            auto is_void = name.compare(u"hr", Qt::CaseInsensitive) == 0
-                           || name.compare(u"br", Qt::CaseInsensitive) == 0
-                           || name.compare(u"img", Qt::CaseInsensitive) == 0
-                           || name.compare(u"input", Qt::CaseInsensitive) == 0;
-
-            if (closing) {
-                i = tag_end + 1;
-                depth--;
-
-                if (depth == 0 && !found_blocks.isEmpty()) {
-                    auto end = i;
-
-                    while (end < len && html[end] == QLatin1Char('\n')) {
-                        end++;
-                    }
-
-                    found_blocks.last().end = end;
-                }
-
-            } else if (is_void) {
-                if (depth == 0) {
-                    auto end = tag_end + 1;
-
-                    while (end < len && html[end] == QLatin1Char('\n')) {
-                        end++;
-                    }
-
-                    found_blocks.append({ i, name_end, end });
-                }
-
-                i = tag_end + 1;
-
-            } else {
-                if (depth == 0) found_blocks.append({ i, name_end, -1 });
-                depth++;
-                i = tag_end + 1;
-            }
-        }
-
-        QStringList edited_blocks{};
-        edited_blocks.reserve(found_blocks.size());
-        auto index = 0;
-
-        for (const auto& found_block : found_blocks) {
-            if (found_block.end < 0) continue;
-
-            QString block{};
-
-            block.reserve(found_block.end - found_block.start + 20);
-
-            block.append(QStringView(html).mid(
-                found_block.start,
-                found_block.injectAt - found_block.start));
-
-            block.append(u" data-idx='%1'"_s.arg(index++));
-
-            block.append(QStringView(html).mid(
-                found_block.injectAt,
-                found_block.end - found_block.injectAt));
-
-            edited_blocks.append(std::move(block));
-        }
-
-        return edited_blocks;
+        return std::make_shared<MarkdownRenderer>();
     }
 };
 
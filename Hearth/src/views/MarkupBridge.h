@@ -0,0 +1,132 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QWebChannel>
+#include <QWebEnginePage>
+
+#include "core/Debug.h"
+
+namespace Hearth {
+
+using namespace Qt::StringLiterals;
+
+// The markup preview's end of a QWebChannel. Patches go to the page as
+// structured operations (see MarkupWebcode::htmlDoc for the applier that
+// receives them), so nothing is escaped into script source or compiled per
+// update. Patches sent before the page's applier has connected (e.g., right
+// after setHtml) wait here until it has
+class MarkupBridge : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MarkupBridge(QWebEnginePage* page)
+        : QObject(page)
+    {
+        setup_(page);
+    }
+
+    virtual ~MarkupBridge() override { TRACER; }
+
+    // Operations, in the order the applier runs them. Indices are data-idx
+    // values as the page has them before the patch
+
+    static QVariantMap insertOp(int index, bool after, const QString& html)
+    {
+        return { { u"op"_s, u"insert"_s },
+                 { u"index"_s, index },
+                 { u"after"_s, after },
+                 { u"html"_s, html } };
+    }
+
+    static QVariantMap removeOp(int index, int count)
+    {
+        return { { u"op"_s, u"remove"_s },
+                 { u"index"_s, index },
+                 { u"count"_s, count } };
+    }
+
+    // Blocks [index, index + count) get data-idx + shift
+    static QVariantMap reindexOp(int index, int count, int shift)
+    {
+        return { { u"op"_s, u"reindex"_s },
+                 { u"index"_s, index },
+                 { u"count"_s, count },
+                 { u"shift"_s, shift } };
+    }
+
+    static QVariantMap bodyOp(const QString& html)
+    {
+        return { { u"op"_s, u"body"_s }, { u"html"_s, html } };
+    }
+
+    void send(const QVariantList& ops)
+    {
+        if (ops.isEmpty()) return;
+
+        if (ready_)
+            emit patch(ops);
+        else
+            pending_ << ops;
+    }
+
+    // For a new page load, whose applier will call ready() again
+    void reset()
+    {
+        ready_ = false;
+        pending_.clear();
+    }
+
+signals:
+    void patch(const QVariantList& ops);
+
+    // The page failed to apply a patch and needs its body replaced whole
+    void resyncRequested();
+
+public slots:
+    // Called by the page's applier once it's listening
+    void ready()
+    {
+        ready_ = true;
+
+        for (auto& ops : pending_)
+            emit patch(ops);
+
+        pending_.clear();
+    }
+
+    // Called by the page's applier when a patch fails
+    void resync()
+    {
+        WARN("Preview patch failed; resyncing");
+        emit resyncRequested();
+    }
+
+private:
+    bool ready_ = false;
+    QList<QVariantList> pending_{};
+
+    void setup_(QWebEnginePage* page)
+    {
+        auto channel = new QWebChannel(page);
+        channel->registerObject(u"bridge"_s, this);
+        page->setWebChannel(channel);
+    }
+};
+
+} // namespace Hearth
@@ -19,6 +19,14 @@ namespace Hearth::MarkupWebcode {
 
 using namespace Qt::StringLiterals;
 
+// The page includes the patch applier, which listens on the view's
+// MarkupBridge. Each patch it receives is a list of operations (see
+// MarkupBridge) run in order against the page's blocks, indexed by data-idx
+// as they were before the patch. Patches arriving together are applied in
+// one animation frame, and the scroll position is kept. If a patch fails, the
+// page no longer matches what the view thinks it shows, so the applier asks
+// for a resync (see MarkupBridge::resync) and ignores patches until the
+// whole-body replacement that follows
 inline QString
 htmlDoc(const QString& fontFaceKit, QStringView css, const QString& body)
 {
@@ -27,55 +35,96 @@ htmlDoc(const QString& fontFaceKit, QStringView css, const QString& body)
 <html>
     <head>
         <style>%1%2</style>
-    </head>
-    <body>
-        %3
-    </body>
-</html>
-)"_s;
+        <script src="qrc:///qtwebchannel/qwebchannel.js"></script>
+        <script>
+(function() {
+    var bridge = null;
+    var queue = [];
+    var scheduled = false;
+    var resyncing = false;
 
-    return s.arg(fontFaceKit, css, body);
-}
+    function indexBlocks() {
+        var b = [];
+        document.querySelectorAll("[data-idx]").forEach(function(e) {
+            b[e.dataset.idx] = e;
+        });
+        return b;
+    }
 
-inline QString jsOuterHtml(int index, const QString& escaped)
-{
-    static const auto s = uR"JS(
-document.querySelector("[data-idx='%1']").outerHTML = `%2`;
-)JS"_s;
+    function apply(ops) {
+        var b = indexBlocks();
 
-    return s.arg(index).arg(escaped);
-}
+        ops.forEach(function(op) {
+            var i;
 
-inline QString jsPatchHtmlBody(const QString& statements)
-{
-    // Double RAF (See:
-    // https://stackoverflow.com/questions/44145740/how-does-double-requestanimationframe-work)
-    static const auto s = uR"JS(
-var lastScrollY = window.scrollY;
-%1
-requestAnimationFrame(function() {
-    requestAnimationFrame(function() {
-        window.scrollTo(0, lastScrollY);
-    });
-});
-)JS"_s;
+            switch (op.op) {
+            case "insert":
+                b[op.index].insertAdjacentHTML(
+                    op.after ? "afterend" : "beforebegin",
+                    op.html);
+                break;
+            case "remove":
+                for (i = op.index; i < op.index + op.count; ++i) b[i].remove();
+                break;
+            case "reindex":
+                for (i = op.index; i < op.index + op.count; ++i)
+                    b[i].dataset.idx = i + op.shift;
+                break;
+            case "body":
+                document.body.innerHTML = op.html;
+                b = indexBlocks();
+                break;
+            }
+        });
+    }
 
-    return s.arg(statements);
-}
+    function flush() {
+        scheduled = false;
+        var lastScrollY = window.scrollY;
+
+        queue.splice(0).forEach(function(ops) {
+            if (resyncing && (ops.length === 0 || ops[0].op !== "body")) return;
+
+            try {
+                apply(ops);
+                resyncing = false;
+            } catch (e) {
+                console.error("Preview patch failed: " + e);
+
+                if (!resyncing) {
+                    resyncing = true;
+                    bridge.resync();
+                }
+            }
+        });
 
-inline QString jsReplaceHtmlBody(const QString& body)
-{
-    static const auto s = uR"JS(
-var lastScrollY = window.scrollY;
-document.body.innerHTML = `%1`;
-requestAnimationFrame(function() {
-    requestAnimationFrame(function() {
         window.scrollTo(0, lastScrollY);
+    }
+
+    new QWebChannel(qt.webChannelTransport, function(channel) {
+        bridge = channel.objects.bridge;
+
+        bridge.patch.connect(function(ops) {
+            queue.push(ops);
+
+            if (!scheduled) {
+                scheduled = true;
+                requestAnimationFrame(flush);
+            }
+        });
+
+        bridge.ready();
     });
-});
-)JS"_s;
+})();
+        </script>
+    </head>
+    <body>
+        %3
+    </body>
+</html>
+)"_s;
 
-    return s.arg(body);
+    return s.arg(fontFaceKit, css, body);
 }
 
 } // namespace Hearth::MarkupWebcode
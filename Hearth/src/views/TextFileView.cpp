@@ -48,6 +48,7 @@ QWidget* TextFileView::setupWidget()
 
     text_model->registerViewDocument(view_doc);
     editor_->setDocument(view_doc);
+    viewDocument_ = view_doc;
 
     connect(
         text_model,
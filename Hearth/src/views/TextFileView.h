@@ -13,11 +13,16 @@
 #pragma once
 
 #include <QFont>
+#include <QHideEvent>
+#include <QScrollBar>
+#include <QShowEvent>
 #include <QTextCursor>
+#include <QTextDocument>
 #include <QTextOption>
 #include <QWidget>
 
 #include "core/Debug.h"
+#include "core/Time.h"
 #include "core/Tr.h"
 #include "menus/MenuBuilder.h"
 #include "menus/MenuShortcuts.h"
@@ -31,7 +36,12 @@ namespace Hearth {
 
 // Text editing view using PlainTextEdit for content display and editing
 // operations (cut/copy/paste/select/undo/redo) with clipboard- and
-// selection-change notification
+// selection-change notification.
+//
+// A view hidden for a while (a background tab, say) detaches its document from
+// the model and empties it, and rebuilds it from the prime when shown again,
+// so memory and per-keystroke routing scale with visible views only (see
+// PrimeDocument.md)
 class TextFileView : public AbstractFileView
 {
     Q_OBJECT
@@ -51,6 +61,11 @@ public:
     // Let our menu-defined shortcuts be the default by removing Qt's
     virtual bool eventFilter(QObject* watched, QEvent* event) override
     {
+        // Catch up on deltas the model queued for us before we can be edited
+        if (watched == editor_ && event->type() == QEvent::FocusIn)
+            if (auto text_model = qobject_cast<TextFileModel*>(model()))
+                text_model->flushPendingDeltas();
+
         if (watched == editor_ && event->type() == QEvent::ShortcutOverride) {
             auto key_event = static_cast<QKeyEvent*>(event);
 
@@ -112,9 +127,77 @@ protected:
     // (Calls Application)
     virtual QWidget* setupWidget() override;
 
+    virtual void showEvent(QShowEvent* event) override
+    {
+        AbstractFileView::showEvent(event);
+
+        detachDelayer_->stop();
+        if (detached_) reattach_();
+    }
+
+    virtual void hideEvent(QHideEvent* event) override
+    {
+        AbstractFileView::hideEvent(event);
+        if (viewDocument_ && !detached_) detachDelayer_->start();
+    }
+
 private:
+    // Long enough that flipping between tabs doesn't rebuild documents
+    static constexpr auto DETACH_DELAY_MSECS_ = 5000;
+
     PlainTextEdit* editor_ = nullptr;
     KeyFilters* keyFilters_ = new KeyFilters(this);
+    QTextDocument* viewDocument_ = nullptr;
+
+    bool detached_ = false;
+    Time::Delayer* detachDelayer_ =
+        Time::newDelayer(this, [this] { detach_(); }, DETACH_DELAY_MSECS_);
+
+    // Restored (as closely as edits made meanwhile allow) on reattach
+    struct DetachedState_
+    {
+        int anchor = 0;
+        int position = 0;
+        int scroll = 0;
+    } detachedState_{};
+
+    /// TODO PD
+    void detach_()
+    {
+        if (detached_ || isVisible() || !editor_ || !viewDocument_) return;
+
+        auto text_model = qobject_cast<TextFileModel*>(model());
+        if (!text_model) return;
+
+        auto cursor = editor_->textCursor();
+        detachedState_ = { cursor.anchor(),
+                           cursor.position(),
+                           editor_->verticalScrollBar()->value() };
+
+        text_model->unregisterViewDocument(viewDocument_);
+        viewDocument_->clear();
+        detached_ = true;
+    }
+
+    /// TODO PD
+    void reattach_()
+    {
+        auto text_model = qobject_cast<TextFileModel*>(model());
+        if (!text_model || !editor_ || !viewDocument_) return;
+
+        text_model->registerViewDocument(viewDocument_);
+        detached_ = false;
+
+        auto max_pos = viewDocument_->characterCount() - 1;
+        QTextCursor cursor(viewDocument_);
+        cursor.setPosition(qMin(detachedState_.anchor, max_pos));
+        cursor.setPosition(
+            qMin(detachedState_.position, max_pos),
+            QTextCursor::KeepAnchor);
+
+        editor_->setTextCursor(cursor);
+        editor_->verticalScrollBar()->setValue(detachedState_.scroll);
+    }
 
 private slots:
     void onEditorCustomContextMenuRequested_(const QPoint& pos)
@@ -68,6 +68,8 @@ signals:
     void fileModelExternallyModified(AbstractFileModel* fileModel);
     void fileModelPathInvalidated(AbstractFileModel* fileModel);
     void fileModelReloadRequested(AbstractFileModel* fileModel);
+    void
+    fileModelLoadProgressChanged(AbstractFileModel* fileModel, int percent);
     void settingChanged(const QString& key, const QVariant& value);
 };
 
@@ -17,14 +17,13 @@
 
 #include <QAbstractItemModel>
 #include <QDockWidget>
-#include <QDomDocument>
-#include <QDomElement>
 #include <QHash>
 #include <QList>
 #include <QModelIndex>
 #include <QModelIndexList>
 #include <QObject>
 #include <QPoint>
+#include <QPointer>
 #include <QSet>
 #include <QSplitter>
 #include <QStatusBar>
@@ -59,7 +58,9 @@
 #include "workspaces/Backup.h"
 #include "workspaces/Bus.h"
 #include "workspaces/NotebookColorChip.h"
+#include "workspaces/NotebookExtractor.h"
 #include "workspaces/NotebookImport.h"
+#include "workspaces/NotebookArchiver.h"
 #include "workspaces/NotebookLockfile.h"
 #include "workspaces/SaveFailMessageBox.h"
 #include "workspaces/SavePrompt.h"
@@ -100,6 +101,12 @@ public:
     {
         TRACER;
 
+        // Let an in-flight save finish reading the working directory, without
+        // the usual UI follow-up
+        disconnect(archiver_, nullptr, this, nullptr);
+        archiver_->waitForFinished();
+        extractor_->stop();
+
         clearRecoveryState_(); /// TODO BA
         workingDir_.remove();
     }
@@ -195,9 +202,9 @@ protected:
         // user-visible root. When nothing is selected, TreeView::currentIndex()
         // returns an invalid QModelIndex.
         //
-        // However, NbxModel::elementAt_({}) maps invalid indices to
-        // dom_.documentElement(), which is <nbx> (the true DOM root containing
-        // both <notebook> and <trash>).
+        // However, NbxModel::nodeAt_({}) maps invalid indices to the tree's
+        // root, which is <nbx> (the true root containing both <notebook> and
+        // <trash>).
         //
         // This mismatch means Notebook item adding methods must explicitly pass
         // notebookIndex() as a fallback when currentIndex() is invalid,
@@ -209,6 +216,8 @@ protected:
     virtual bool canCloseWindow(Window* window) override
     {
         if (windows->count() > 1) return true;
+
+        archiver_->waitForFinished();
         if (nbxPath_.exists() && !nbxModel_->isModified()) return true;
 
         // Last window and needs saving
@@ -217,6 +226,7 @@ protected:
 
     virtual bool canCloseAllWindows(const QList<Window*>& windows) override
     {
+        archiver_->waitForFinished();
         if (nbxPath_.exists() && !nbxModel_->isModified()) return true;
         return promptWorkspaceClosingSave_(windows.last());
     }
@@ -244,11 +254,14 @@ protected:
             .enabledToggle(
                 state,
                 MenuScope::Workspace,
-                [this] { return isModified_(); })
+                [this] { return isModified_() && !archiver_->isRunning(); })
 
             .action(Tr::nxSaveAs())
             .onUserTrigger(this, [this, window] { saveAs_(window); })
-            .shortcut(MenuShortcuts::SAVE_AS);
+            .shortcut(MenuShortcuts::SAVE_AS)
+            .enabledToggle(state, MenuScope::Workspace, [this] {
+                return !archiver_->isRunning();
+            });
     }
 
 private:
@@ -258,6 +271,14 @@ private:
         explicit operator bool() const noexcept { return failed.isEmpty(); }
     };
 
+    // State captured when an archive write starts, applied when it finishes
+    struct PendingSave_
+    {
+        Coco::Path path{};
+        NbxModel::Snapshot snapshot{};
+        QPointer<Window> window{};
+    };
+
     // Private recovery constructor
     /// TODO BA
     explicit Notebook(
@@ -283,6 +304,15 @@ private:
 
     NbxModel* nbxModel_ = new NbxModel(this);
 
+    // Archives are written off the GUI thread. While one is in progress, Save
+    // and Save As are disabled and permanent deletion is refused
+    NotebookArchiver* archiver_ = new NotebookArchiver(this);
+    PendingSave_ pendingSave_{};
+    bool lastSaveSucceeded_ = false;
+
+    // Content is extracted lazily from the archive (see NotebookExtractor)
+    NotebookExtractor* extractor_ = nullptr;
+
     // This should be cleared after the first save or discard
     QSet<QString> recoveryDirtyUuids_{}; /// TODO BA
 
@@ -345,7 +375,8 @@ private:
             //...
 
         } else {
-            Nbx::Io::extract(nbxPath_, working_dir_path);
+            // Content is extracted on demand (see startExtractor_)
+            Nbx::Io::extractSkeleton(nbxPath_, working_dir_path);
             // TODO: Verification (comparing Manifest file elements to
             // content dir files, i.e. making sure Trash exists, checking
             // all file UUIDs have corresponding files, etc.)
@@ -357,6 +388,7 @@ private:
             / "Settings.ini"); // This needs to be after extraction!
 
         nbxModel_->load(working_dir_path);
+        startExtractor_();
 
         connect(
             nbxModel_,
@@ -370,12 +402,55 @@ private:
             this,
             &Notebook::onNbxModelFileRenamed_);
 
+        connect(
+            archiver_,
+            &NotebookArchiver::progressChanged,
+            this,
+            [this](int percent) { colorBars->progress(percent); });
+
+        connect(
+            archiver_,
+            &NotebookArchiver::finished,
+            this,
+            &Notebook::onArchiverFinished_);
+
         connectBusEvents_();
 
         /// TODO BA
         if (!recoveryDirtyUuids_.isEmpty()) applyRecoveryState_();
     }
 
+    // Also covers recovery, where the previous session may not have
+    // extracted everything
+    void startExtractor_()
+    {
+        extractor_ = new NotebookExtractor(nbxPath_, workingDir_.path(), this);
+        files->setBeforeOpenHook(this, &Notebook::beforeFileOpenHook_);
+
+        if (!nbxPath_.exists()) return;
+
+        QStringList entry_names{};
+        auto roots = { nbxModel_->notebookIndex(), nbxModel_->trashIndex() };
+
+        for (auto& root : roots)
+            for (auto& info : nbxModel_->fileInfosAt(root))
+                entry_names << entryName_(info.relPath);
+
+        extractor_->start(entry_names);
+    }
+
+    static QString entryName_(const Coco::Path& relPath)
+    {
+        return QString::fromStdString(relPath.genericString());
+    }
+
+    void beforeFileOpenHook_(const Coco::Path& path)
+    {
+        if (!workingDir_.isValid()) return;
+        auto rel = path.lexicallyRelative(workingDir_.path());
+        extractor_->ensureExtracted(entryName_(rel));
+    }
+
     void connectBusEvents_()
     {
         connect(bus, &Bus::windowCreated, this, [this](Window* window) {
@@ -540,27 +615,10 @@ private:
                 if (path.isEmpty()) return false;
             }
 
-            auto save_result = saveModifiedModels_();
-            if (!save_result) {
-                colorBars->red();
-                auto fail_paths = saveFailDisplayPaths_(save_result.failed);
-                SaveFailMessageBox::exec(fail_paths, window);
-
-                return false;
-            }
-
-            nbxModel_->write(workingDir_.path());
-
-            /// TODO BA
-            if (!Nbx::Io::compress(
-                    path,
-                    workingDir_.path(),
-                    makeBackupHook_())) {
-                colorBars->red();
-                SaveFailMessageBox::exec(path, window);
-
-                return false;
-            }
+            // Closing can't proceed without the result, so wait for it here
+            if (!startSave_(window, path)) return false;
+            archiver_->waitForFinished();
+            if (!lastSaveSucceeded_) return false;
 
             [[fallthrough]]; // Clean-up after success
         }
@@ -642,6 +700,7 @@ private:
         auto info = nbxModel_->fileInfoAt(index);
         if (!info.isValid()) return;
 
+        extractor_->ensureExtracted(entryName_(info.relPath));
         auto source = workingDir_.path() / info.relPath;
         if (!source.exists()) return;
 
@@ -784,6 +843,9 @@ private:
         if (!window || !index.isValid()) return false;
         if (!workingDir_.isValid()) return false;
 
+        // The archive being written may still need these files
+        if (archiver_->isRunning()) return false;
+
         auto count = nbxModel_->descendantCount(index);
         if (index != nbxModel_->trashIndex()) ++count;
         if (count == 0) return false;
@@ -795,6 +857,8 @@ private:
         QSet<Coco::Path> paths{};
 
         for (auto& info : file_infos) {
+            // Never-extracted files have nothing to delete from disk
+            if (extractor_->discard(entryName_(info.relPath))) continue;
             paths << working_dir_path / info.relPath;
         }
 
@@ -835,90 +899,77 @@ private:
     void save_(Window* window)
     {
         if (!window) return;
+        if (archiver_->isRunning()) return;
         if (nbxPath_.exists() && !nbxModel_->isModified()) return;
 
         Coco::Path path = nbxPath_;
-        auto saved_as = false;
 
         if (!nbxPath_.exists()) {
             path = promptSaveAs_(window);
             if (path.isEmpty()) return;
-            saved_as = true;
         }
 
-        auto save_result = saveModifiedModels_();
-        if (!save_result) {
-            colorBars->red();
-            auto fail_paths = saveFailDisplayPaths_(save_result.failed);
-            SaveFailMessageBox::exec(fail_paths, window);
-
-            return;
-        }
-
-        nbxModel_->write(workingDir_.path());
-
-        /// TODO BA
-        if (!Nbx::Io::compress(path, workingDir_.path(), makeBackupHook_())) {
-            colorBars->red();
-            SaveFailMessageBox::exec(path, window);
-
-            return;
-        }
-
-        clearRecoveryState_(); /// TODO BA
-
-        if (saved_as) {
-            nbxPath_ = path;
-            windows->setSubtitle(name());
-        }
-
-        nbxModel_->resetSnapshot();
-        updateWindowsFlags_();
-        refreshMenus(MenuScope::Workspace);
-        colorBars->green();
+        startSave_(window, path);
     }
 
     void saveAs_(Window* window)
     {
         if (!window) return;
+        if (archiver_->isRunning()) return;
 
         auto new_path = promptSaveAs_(window);
         if (new_path.isEmpty()) return;
 
+        startSave_(window, new_path);
+    }
+
+    // Saves modified models, then snapshots the manifest, file list, and DOM
+    // state before handing the archive write to the archiver. Edits made while
+    // it runs land in the working directory and leave the Notebook modified.
+    // The rest happens in onArchiverFinished_
+    bool startSave_(Window* window, const Coco::Path& path)
+    {
         auto save_result = saveModifiedModels_();
         if (!save_result) {
             colorBars->red();
             auto fail_paths = saveFailDisplayPaths_(save_result.failed);
             SaveFailMessageBox::exec(fail_paths, window);
 
-            return;
+            return false;
         }
 
-        nbxModel_->write(workingDir_.path());
-
-        /// TODO BA
-        if (!Nbx::Io::compress(
-                new_path,
-                workingDir_.path(),
-                makeBackupHook_())) {
-            colorBars->red();
-            SaveFailMessageBox::exec(new_path, window);
-
-            return;
-        }
+        auto working_dir_path = workingDir_.path();
+        nbxModel_->write(working_dir_path);
 
-        clearRecoveryState_(); /// TODO BA
+        // The archive being replaced is also the extractor's source. Pausing
+        // first (which waits out any entry being extracted) keeps the file
+        // list and pending entries from disagreeing: an entry finishing
+        // between the two would otherwise be in neither and left out
+        extractor_->setPaused(true);
 
-        nbxPath_ = new_path;
-        windows->setSubtitle(name());
-        for (auto& chip : colorChips_) {
-            chip->setNbx(nbxPath_);
+        /// TODO BA
+        // The current archive (if any) is the base for unchanged entries, even
+        // for Save As
+        Nbx::Io::CompressOptions options{};
+        options.baseArchivePath = nbxPath_;
+        options.entries = Coco::allFilePaths(working_dir_path);
+        options.baseOnlyEntries = extractor_->pendingEntries();
+        options.manifest = nbxModel_->manifest();
+        options.textLevel = qBound(
+            Ini::Limits::NOTEBOOK_COMPRESSION_MIN,
+            settings->get<int>(Ini::Keys::NOTEBOOK_COMPRESSION),
+            Ini::Limits::NOTEBOOK_COMPRESSION_MAX);
+        options.beforeOverwriteHook = makeBackupHook_();
+
+        pendingSave_ = { path, nbxModel_->snapshot(), window };
+        if (!archiver_->start(path, working_dir_path, std::move(options))) {
+            extractor_->setPaused(false);
+            return false;
         }
 
-        nbxModel_->resetSnapshot();
-        updateWindowsFlags_();
+        colorBars->progress(0);
         refreshMenus(MenuScope::Workspace);
-        colorBars->green();
+        return true;
     }
 
     void showTrashViewContextMenu_(
@@ -933,6 +984,7 @@ private:
         auto valid = index.isValid();
         auto has_children = nbxModel_->hasChildren(index);
         auto is_expanded = has_children && trashView->isExpanded(index);
+        auto saving = archiver_->isRunning();
 
         MenuBuilder(MenuBuilder::ContextMenu, window)
             .actionIf(
@@ -961,9 +1013,11 @@ private:
             .onUserTrigger(
                 this,
                 [this, window, index] { deleteTrashItem_(window, index); })
+            .enabled(!saving)
             .separatorIf(valid)
             .action(Tr::nbEmptyTrash())
             .onUserTrigger(this, [this, window] { emptyTrash_(window); })
+            .enabled(!saving)
             .popup(globalPos);
     }
 
@@ -978,6 +1032,40 @@ private:
     }
 
 private slots:
+    void onArchiverFinished_(bool success)
+    {
+        auto pending = std::exchange(pendingSave_, {});
+        lastSaveSucceeded_ = success;
+
+        // The new archive holds every entry not yet extracted
+        if (success) extractor_->setArchivePath(pending.path);
+        extractor_->setPaused(false);
+
+        if (!success) {
+            colorBars->red();
+            SaveFailMessageBox::exec(pending.path, pending.window);
+            refreshMenus(MenuScope::Workspace);
+
+            return;
+        }
+
+        clearRecoveryState_(); /// TODO BA
+
+        if (pending.path != nbxPath_) {
+            nbxPath_ = pending.path;
+            windows->setSubtitle(name());
+            for (auto& chip : colorChips_) {
+                chip->setNbx(nbxPath_);
+            }
+        }
+
+        // Only what was archived counts as saved
+        nbxModel_->resetSnapshot(pending.snapshot);
+        updateWindowsFlags_();
+        refreshMenus(MenuScope::Workspace);
+        colorBars->green();
+    }
+
     // TODO: Could remove working dir validity check; also writeManifest could
     // return bool?
     void onNbxModelDomChanged_()
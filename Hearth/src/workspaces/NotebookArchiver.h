@@ -0,0 +1,122 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPromise>
+#include <QtConcurrent>
+
+#include <Coco/Path.h>
+
+#include "core/Debug.h"
+#include "nbx/Nbx.h"
+
+namespace Hearth {
+
+// Runs Nbx::Io::compress on the global thread pool, one archive at a time.
+// Everything compress needs from the GUI thread (the manifest, the entry list)
+// must be snapshotted into the options before starting
+class NotebookArchiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NotebookArchiver(QObject* parent = nullptr)
+        : QObject(parent)
+    {
+        setup_();
+    }
+
+    virtual ~NotebookArchiver() override
+    {
+        TRACER;
+        watcher_->waitForFinished();
+    }
+
+    bool isRunning() const noexcept { return running_; }
+
+    // Returns false (and does nothing) if an archive is already being written
+    bool start(
+        const Coco::Path& archivePath,
+        const Coco::Path& workingDir,
+        Nbx::Io::CompressOptions options)
+    {
+        if (running_) return false;
+        running_ = true;
+
+        auto task = [archivePath, workingDir, options](
+                        QPromise<bool>& promise) mutable {
+            promise.setProgressRange(0, 100);
+
+            options.progressHook = [&promise](qsizetype done, qsizetype total) {
+                promise.setProgressValue(
+                    total > 0 ? static_cast<int>(done * 100 / total) : 100);
+            };
+
+            promise.addResult(
+                Nbx::Io::compress(archivePath, workingDir, options));
+        };
+
+        watcher_->setFuture(QtConcurrent::run(task));
+        return true;
+    }
+
+    // Blocks until the archive in progress (if any) is written, then emits
+    // finished before returning. For paths that can't continue without the
+    // result, like closing the Notebook
+    void waitForFinished()
+    {
+        if (!running_) return;
+        watcher_->waitForFinished();
+        onWatcherFinished_();
+    }
+
+signals:
+    void progressChanged(int percent);
+    void finished(bool success);
+
+private:
+    QFutureWatcher<bool>* watcher_ = new QFutureWatcher<bool>(this);
+    bool running_ = false;
+
+    void setup_()
+    {
+        connect(
+            watcher_,
+            &QFutureWatcher<bool>::progressValueChanged,
+            this,
+            &NotebookArchiver::progressChanged);
+
+        connect(
+            watcher_,
+            &QFutureWatcher<bool>::finished,
+            this,
+            &NotebookArchiver::onWatcherFinished_);
+    }
+
+private slots:
+    void onWatcherFinished_()
+    {
+        // May already have been handled by waitForFinished
+        if (!running_) return;
+        running_ = false;
+
+        auto future = watcher_->future();
+        auto success = future.resultCount() > 0 && future.result();
+        emit finished(success);
+    }
+};
+
+} // namespace Hearth
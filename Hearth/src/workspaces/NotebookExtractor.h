@@ -0,0 +1,251 @@
+/*
+ * Hearth — a plain-text-first workbench for creative writing
+ * Copyright (C) 2025-2026 fairybow
+ *
+ * This program is free software, redistributable and/or modifiable under the
+ * terms of the GNU GPL v3. It's distributed in the hope that it will be useful
+ * but without any warranty (even the implied warranty of merchantability or
+ * fitness for a particular purpose)
+ *
+ * See the LICENSE file or visit <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <miniz.h>
+
+#include <Coco/Path.h>
+
+#include "core/Debug.h"
+#include "nbx/Nbx.h"
+
+namespace Hearth {
+
+// Extracts a Notebook's content entries lazily. Opening a Notebook extracts
+// only its skeleton (see Nbx::Io::extractSkeleton); the rest is extracted
+// either on demand (ensureExtracted, e.g. when a file is opened) or by a
+// lowest-priority background thread, whichever comes first.
+//
+// Entries not yet extracted have no working copy, so saves must carry them
+// over from the archive (see pendingEntries). All public methods are called
+// from the GUI thread
+class NotebookExtractor : public QObject
+{
+    Q_OBJECT
+
+public:
+    NotebookExtractor(
+        const Coco::Path& archivePath,
+        const Coco::Path& workingDir,
+        QObject* parent = nullptr)
+        : QObject(parent)
+        , archivePath_(archivePath)
+        , workingDir_(workingDir)
+    {
+    }
+
+    virtual ~NotebookExtractor() override
+    {
+        TRACER;
+        stop();
+    }
+
+    // Queues the given entry names (relative, generic paths) that exist in
+    // the archive but not yet in the working directory, then starts the
+    // background thread
+    void start(const QStringList& entryNames)
+    {
+        if (thread_) return;
+
+        {
+            QMutexLocker locker(&mutex_);
+            if (!openZip_()) return;
+
+            for (auto& name : entryNames) {
+                if (!indices_.contains(name)) continue;
+                if ((workingDir_ / name).exists()) continue;
+                pending_ << name;
+            }
+
+            INFO("{} Notebook entries pending extraction", pending_.size());
+            if (pending_.isEmpty()) {
+                closeZip_();
+                return;
+            }
+        }
+
+        thread_ = QThread::create([this] { run_(); });
+        thread_->start(QThread::LowestPriority);
+    }
+
+    // Stops the background thread. Must be called before the working
+    // directory is removed
+    void stop()
+    {
+        if (!thread_) return;
+
+        {
+            QMutexLocker locker(&mutex_);
+            stopping_ = true;
+            resumed_.wakeAll();
+        }
+
+        thread_->wait();
+        delete thread_;
+        thread_ = nullptr;
+    }
+
+    // Pausing also releases the archive, so it can be replaced (as by a save)
+    void setPaused(bool paused)
+    {
+        QMutexLocker locker(&mutex_);
+        paused_ = paused;
+
+        if (paused_)
+            closeZip_();
+        else
+            resumed_.wakeAll();
+    }
+
+    // Entries are read from here from now on (e.g., after Save As). The new
+    // archive must contain all pending entries
+    void setArchivePath(const Coco::Path& archivePath)
+    {
+        QMutexLocker locker(&mutex_);
+        closeZip_();
+        archivePath_ = archivePath;
+    }
+
+    // Extracts the entry now if it hasn't been yet. Returns false only if the
+    // entry is pending and extraction fails
+    bool ensureExtracted(const QString& entryName)
+    {
+        QMutexLocker locker(&mutex_);
+        if (!pending_.remove(entryName) && !failed_.remove(entryName))
+            return true;
+
+        auto extracted = extract_(entryName);
+        if (paused_ || pending_.isEmpty()) closeZip_();
+
+        return extracted;
+    }
+
+    // Forgets a pending entry (e.g., one being permanently deleted). Returns
+    // true if the entry was pending, meaning it has no working copy
+    bool discard(const QString& entryName)
+    {
+        QMutexLocker locker(&mutex_);
+        auto removed = pending_.remove(entryName);
+        return failed_.remove(entryName) || removed;
+    }
+
+    // Entries without a working copy
+    QStringList pendingEntries() const
+    {
+        QMutexLocker locker(&mutex_);
+        return (pending_ + failed_).values();
+    }
+
+private:
+    Coco::Path archivePath_;
+    Coco::Path workingDir_;
+
+    mutable QMutex mutex_{};
+    QWaitCondition resumed_{};
+    QThread* thread_ = nullptr;
+    bool stopping_ = false;
+    bool paused_ = false;
+
+    // Guarded by mutex_
+    mz_zip_archive zip_{};
+    bool zipOpen_ = false;
+    QHash<QString, int> indices_{};
+    QSet<QString> pending_{};
+    QSet<QString> failed_{};
+
+    // Background thread
+    void run_()
+    {
+        QMutexLocker locker(&mutex_);
+
+        while (!stopping_ && !pending_.isEmpty()) {
+            if (paused_) {
+                resumed_.wait(&mutex_);
+                continue;
+            }
+
+            auto it = pending_.begin();
+            auto name = *it;
+            pending_.erase(it);
+            extract_(name);
+
+            // Let on-demand requests in between entries
+            locker.unlock();
+            QThread::yieldCurrentThread();
+            locker.relock();
+        }
+
+        closeZip_();
+        INFO("Background Notebook extraction finished");
+    }
+
+    // Requires mutex_
+    bool openZip_()
+    {
+        if (zipOpen_) return true;
+
+        zip_ = {};
+        if (!mz_zip_reader_init_file(
+                &zip_,
+                archivePath_.toString().c_str(),
+                0)) {
+            CRITICAL(
+                "NBX archive read failed! Error: {}",
+                mz_zip_get_error_string(mz_zip_get_last_error(&zip_)));
+            return false;
+        }
+
+        indices_ = Nbx::Internal::entryIndices_(&zip_);
+        zipOpen_ = true;
+
+        return true;
+    }
+
+    // Requires mutex_
+    void closeZip_()
+    {
+        if (!zipOpen_) return;
+        mz_zip_reader_end(&zip_);
+        zipOpen_ = false;
+    }
+
+    // Requires mutex_. Failed entries stay pending (in failed_), so that
+    // saves still carry them over
+    bool extract_(const QString& entryName)
+    {
+        auto index = openZip_() ? indices_.value(entryName, -1) : -1;
+
+        if (index < 0 || !Nbx::Internal::extractEntry_(
+                             &zip_,
+                             static_cast<mz_uint>(index),
+                             workingDir_)) {
+            WARN("Failed to extract {}", entryName);
+            failed_ << entryName;
+            return false;
+        }
+
+        return true;
+    }
+};
+
+} // namespace Hearth
@@ -305,6 +305,17 @@ private:
         connect(bus, &Bus::fileModelModificationChanged, this, [this] {
             refreshWindowAndWorkspaceMenus_();
         });
+
+        connect(
+            bus,
+            &Bus::fileModelLoadProgressChanged,
+            this,
+            [this]([[maybe_unused]] AbstractFileModel* fileModel, int percent) {
+                if (percent < 100)
+                    colorBars->progress(percent);
+                else
+                    colorBars->green();
+            });
     }
 
     void createWindowMenuBar_(Window* window);